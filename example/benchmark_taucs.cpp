@@ -0,0 +1,1990 @@
+#include <taucs_matrix.h>
+#include <taucs_solver.h>
+#include <taucs_util.h>
+#include <taucs_factorization.h>
+#include <normal_equations.h>
+#include <parallel_assembler.h>
+#include <block_sparse_matrix.h>
+#include <parallel.h>
+#include <iostream>
+#include <vector>
+#include <string>
+#include <map>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <cmath>
+
+
+#define  TAUCS_CORE_DOUBLE
+extern "C" {
+#include <taucs.h>
+}
+
+
+// Wall clock time in seconds
+static double now() {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+// Degrees of freedom of hexahedral element (x, y, z) of a structured
+// (n x n x n)-node mesh with 3 dofs per node. An element of the given order
+// spans (order + 1)^3 nodes, i.e., 8 nodes for trilinear and 27 for 
+// triquadratic elements. Returns the number of dofs written to dofs[].
+static int hex_element_dofs(int n, int order, int x, int y, int z, int* dofs) {
+	int k = 0;
+	for (int dz=0; dz<=order; ++dz) {
+		for (int dy=0; dy<=order; ++dy) {
+			for (int dx=0; dx<=order; ++dx) {
+				int node = (x * order + dx) + (y * order + dy) * n + (z * order + dz) * n * n;
+				for (int d=0; d<3; ++d)
+					dofs[k++] = node * 3 + d;
+			}
+		}
+	}
+	return k;
+}
+
+
+// The 7-point finite difference Laplacian of an (n x n x n) grid, plus
+// shift * I (lower triangle only, symmetric positive definite)
+static void laplacian_3d(int n, double shift, TaucsMatrix& A) {
+	for (int z=0; z<n; ++z) {
+		for (int y=0; y<n; ++y) {
+			for (int x=0; x<n; ++x) {
+				int i = x + y * n + z * n * n;
+				A.set_coef(i, i, 6.0 + shift);
+				if (x > 0) A.set_coef(i, i - 1, -1.0);
+				if (y > 0) A.set_coef(i, i - n, -1.0);
+				if (z > 0) A.set_coef(i, i - n * n, -1.0);
+			}
+		}
+	}
+}
+
+
+// The 5-point finite difference discretization of a convection-diffusion
+// operator on an (n x n) grid (non-symmetric)
+static void convection_diffusion_2d(int n, double convection, TaucsMatrix& A) {
+	for (int y=0; y<n; ++y) {
+		for (int x=0; x<n; ++x) {
+			int i = x + y * n;
+			A.set_coef(i, i, 4.0 + convection);
+			if (x > 0)     A.set_coef(i, i - 1, -1.0 - convection);
+			if (x < n - 1) A.set_coef(i, i + 1, -1.0);
+			if (y > 0)     A.set_coef(i, i - n, -1.0);
+			if (y < n - 1) A.set_coef(i, i + n, -1.0);
+		}
+	}
+}
+
+
+//////////////////////////////////////////////////////////////////////////
+
+
+// The column used before the sorted one: linear scan over the indices.
+// Kept here only as the reference for benchmark_assembly().
+class ScanColumn
+{
+public:
+	void add_coef(int index, double val) {
+		for (std::size_t i=0; i<m_indices.size(); ++i) {
+			if (m_indices[i] == index) {
+				m_values[i] += val;
+				return;
+			}
+		}
+		m_indices.push_back(index);
+		m_values.push_back(val);
+	}
+
+	std::vector<double>	m_values;
+	std::vector<int>	m_indices;
+};
+
+
+// Assemble the (non-symmetric) stiffness pattern of a 3D hexahedral mesh,
+// with the linear scan columns and with SparseMatrix, and compare the memory
+// used by the per-column vectors and by the pool of SparseMatrix.
+static bool benchmark_assembly(int order, int num_elements) {
+	const int n = num_elements * order + 1;	// nodes per side
+	const int dim = n * n * n * 3;			// 3 dofs per node
+
+	std::cout << "assembly of a " << dim << " x " << dim << " matrix ("
+		<< num_elements * num_elements * num_elements << " hexahedral elements of order " << order << ")" << std::endl;
+
+	std::vector<int> dofs(3 * (order + 1) * (order + 1) * (order + 1));
+
+	// linear scan
+	double t0 = now();
+	std::vector<ScanColumn> columns(dim);
+	for (int z=0; z<num_elements; ++z) {
+		for (int y=0; y<num_elements; ++y) {
+			for (int x=0; x<num_elements; ++x) {
+				int k = hex_element_dofs(n, order, x, y, z, &dofs[0]);
+				for (int j=0; j<k; ++j) {
+					for (int i=0; i<k; ++i)
+						columns[dofs[j]].add_coef(dofs[i], 1.0);
+				}
+			}
+		}
+	}
+	double t_scan = now() - t0;
+
+	// sorted columns
+	t0 = now();
+	TaucsMatrix M(dim, dim, false);
+	for (int z=0; z<num_elements; ++z) {
+		for (int y=0; y<num_elements; ++y) {
+			for (int x=0; x<num_elements; ++x) {
+				int k = hex_element_dofs(n, order, x, y, z, &dofs[0]);
+				for (int j=0; j<k; ++j) {
+					for (int i=0; i<k; ++i)
+						M.add_coef(dofs[i], dofs[j], 1.0);
+				}
+			}
+		}
+	}
+	double t_sorted = now() - t0;
+
+	std::size_t nnz = 0;
+	for (int j=0; j<dim; ++j)
+		nnz += columns[j].m_indices.size();
+
+	// memory of the per-column vectors (counting 16 bytes of heap overhead per allocation)
+	std::size_t scan_memory = dim * sizeof(ScanColumn);
+	for (int j=0; j<dim; ++j) {
+		if (columns[j].m_indices.capacity() > 0)
+			scan_memory += columns[j].m_indices.capacity() * sizeof(int) + columns[j].m_values.capacity() * sizeof(double) + 2 * 16;
+	}
+	std::size_t pool_memory = M.memory_usage();
+	M.compact();
+	std::size_t compact_memory = M.memory_usage();
+
+	std::cout << "    nonzeros:        " << nnz << " (" << double(nnz) / dim << " per column)" << std::endl;
+	std::cout << "    linear scan:     " << t_scan << " s" << std::endl;
+	std::cout << "    sorted columns:  " << t_sorted << " s" << std::endl;
+	std::cout << "    bytes per nonzero: per-column vectors " << double(scan_memory) / nnz 
+		<< ", pool " << double(pool_memory) / nnz << ", compacted pool " << double(compact_memory) / nnz << std::endl;
+
+	// both must give the same matrix
+	for (int j=0; j<dim; ++j) {
+		for (std::size_t k=0; k<columns[j].m_indices.size(); ++k) {
+			if (M.get_coef(columns[j].m_indices[k], j) != columns[j].m_values[k])
+				return false;
+		}
+	}
+	return true;
+}
+
+
+
+// Assemble the columns of a small matrix out of order (column 1 before 
+// column 0), so that the pool holds them contiguously but in reverse order,
+// and check the exported TAUCS matrix.
+static bool benchmark_out_of_order_assembly() {
+	const int dim = 4;
+	TaucsMatrix A(dim, dim);
+	for (int j = 1; j >= 0; --j) {
+		for (int i = 0; i < dim; ++i)
+			A.add_coef(i, j, 10.0 * j + i);
+	}
+
+	const taucs_ccs_matrix* a = A.get_taucs_matrix();
+	bool ok = (a != NULL) && a->colptr[0] == 0 && a->colptr[1] == dim &&
+		a->colptr[2] == 2 * dim && a->colptr[3] == 2 * dim && a->colptr[4] == 2 * dim;
+	for (int k = 0; ok && k < 2 * dim; ++k)
+		ok = (a->rowind[k] == k % dim) && (a->values.d[k] == 10.0 * (k / dim) + k % dim);
+
+	std::cout << "out of order assembly of a " << dim << " x " << dim << " matrix: " 
+		<< (ok ? "ok" : "wrong compressed column arrays") << std::endl;
+	return ok;
+}
+
+
+
+// Assemble the same matrix from element triplets, once with add_coef() and 
+// once with the bulk triplet builder.
+static bool benchmark_triplets(int order, int num_elements) {
+	const int n = num_elements * order + 1;	// nodes per side
+	const int dim = n * n * n * 3;			// 3 dofs per node
+
+	// the triplets of all the elements
+	std::vector<int> dofs(3 * (order + 1) * (order + 1) * (order + 1));
+	std::vector<int> element_rows, element_cols;
+	std::vector<double> element_values;
+	for (int z=0; z<num_elements; ++z) {
+		for (int y=0; y<num_elements; ++y) {
+			for (int x=0; x<num_elements; ++x) {
+				int k = hex_element_dofs(n, order, x, y, z, &dofs[0]);
+				for (int j=0; j<k; ++j) {
+					for (int i=0; i<k; ++i) {
+						element_rows.push_back(dofs[i]);
+						element_cols.push_back(dofs[j]);
+						element_values.push_back(1.0 / (1 + i + j));
+					}
+				}
+			}
+		}
+	}
+	int nb_triplets = static_cast<int>(element_values.size());
+
+	// in random order, as produced by a parallel element loop
+	std::vector<int> order_of_arrival(nb_triplets);
+	for (int k=0; k<nb_triplets; ++k)
+		order_of_arrival[k] = k;
+	std::shuffle(order_of_arrival.begin(), order_of_arrival.end(), std::mt19937(2009));
+
+	std::vector<int> rows(nb_triplets), cols(nb_triplets);
+	std::vector<double> values(nb_triplets);
+	for (int k=0; k<nb_triplets; ++k) {
+		rows[k] = element_rows[order_of_arrival[k]];
+		cols[k] = element_cols[order_of_arrival[k]];
+		values[k] = element_values[order_of_arrival[k]];
+	}
+
+	std::cout << "assembly of a " << dim << " x " << dim << " symmetric matrix from " << nb_triplets << " triplets" << std::endl;
+
+	double t0 = now();
+	TaucsMatrix A(dim, dim, true);
+	for (int k=0; k<nb_triplets; ++k)
+		A.add_coef(rows[k], cols[k], values[k]);
+	const taucs_ccs_matrix* a = A.get_taucs_matrix();
+	double t_add = now() - t0;
+
+	t0 = now();
+	TaucsMatrix B(dim, dim, true);
+	B.set_triplets(nb_triplets, &rows[0], &cols[0], &values[0]);
+	const taucs_ccs_matrix* b = B.get_taucs_matrix();
+	double t_set = now() - t0;
+
+	t0 = now();
+	taucs_ccs_matrix* c = TaucsUtil::CreateTaucsMatrixFromTriplets(dim, dim, nb_triplets, 
+		&rows[0], &cols[0], &values[0], TAUCS_DOUBLE | TAUCS_SYMMETRIC | TAUCS_LOWER);
+	double t_ccs = now() - t0;
+
+	std::cout << "    add_coef():                    " << t_add << " s" << std::endl;
+	std::cout << "    set_triplets():                " << t_set << " s" << std::endl;
+	std::cout << "    CreateTaucsMatrixFromTriplets: " << t_ccs << " s" << std::endl;
+
+	// the three matrices must be identical
+	int nnz = a->colptr[dim];
+	bool same = (b->colptr[dim] == nnz) && (c->colptr[dim] == nnz) &&
+		memcmp(a->colptr, b->colptr, (dim + 1) * sizeof(int)) == 0 &&
+		memcmp(a->colptr, c->colptr, (dim + 1) * sizeof(int)) == 0 &&
+		memcmp(a->rowind, b->rowind, nnz * sizeof(int)) == 0 &&
+		memcmp(a->rowind, c->rowind, nnz * sizeof(int)) == 0 &&
+		memcmp(a->values.d, b->values.d, nnz * sizeof(double)) == 0 &&
+		memcmp(a->values.d, c->values.d, nnz * sizeof(double)) == 0;
+	taucs_ccs_free(c);
+
+	// B keeps the elements in its TAUCS matrix only (A also has its columns)
+	std::cout << "    memory: add_coef() " << A.memory_usage() / 1048576.0 << " MB, set_triplets() "
+		<< B.memory_usage() / 1048576.0 << " MB" << std::endl;
+	if (B.memory_usage() >= A.memory_usage())
+		same = false;
+
+	// Inserting an element outside the pattern of the triplets
+	A.add_coef(dim - 1, 0, 1.0);
+	B.add_coef(dim - 1, 0, 1.0);
+	a = A.get_taucs_matrix();
+	b = B.get_taucs_matrix();
+	nnz = a->colptr[dim];
+	same = same && (b->colptr[dim] == nnz) &&
+		memcmp(a->colptr, b->colptr, (dim + 1) * sizeof(int)) == 0 &&
+		memcmp(a->rowind, b->rowind, nnz * sizeof(int)) == 0 &&
+		memcmp(a->values.d, b->values.d, nnz * sizeof(double)) == 0;
+
+	return same;
+}
+
+
+
+// Re-assemble a matrix several times with the same pattern (as in a Newton loop),
+// with a modifiable pattern, with a frozen pattern, and with precomputed slots.
+static bool benchmark_frozen_pattern(int order, int num_elements, int num_iterations) {
+	const int n = num_elements * order + 1;	// nodes per side
+	const int dim = n * n * n * 3;			// 3 dofs per node
+
+	std::cout << "re-assembly of a " << dim << " x " << dim << " symmetric matrix, "
+		<< num_iterations << " iterations" << std::endl;
+
+	std::vector<int> dofs(3 * (order + 1) * (order + 1) * (order + 1));
+	TaucsMatrix A(dim, dim, true);
+	TaucsMatrix B(dim, dim, true);
+	double t_modifiable = 0, t_frozen = 0, t_slots = 0;
+
+	std::vector<int> slots;
+	for (int iter=0; iter<num_iterations; ++iter) {
+		double scale = 1.0 + iter;
+
+		// modifiable pattern
+		double t0 = now();
+		A.set_zero();
+		for (int z=0; z<num_elements; ++z) {
+			for (int y=0; y<num_elements; ++y) {
+				for (int x=0; x<num_elements; ++x) {
+					int k = hex_element_dofs(n, order, x, y, z, &dofs[0]);
+					for (int j=0; j<k; ++j) {
+						for (int i=0; i<k; ++i)
+							A.add_coef(dofs[i], dofs[j], scale);
+					}
+				}
+			}
+		}
+		A.get_taucs_matrix();
+		t_modifiable += now() - t0;
+
+		// frozen pattern (frozen after the first assembly)
+		if (iter == 0) {
+			for (int z=0; z<num_elements; ++z) {
+				for (int y=0; y<num_elements; ++y) {
+					for (int x=0; x<num_elements; ++x) {
+						int k = hex_element_dofs(n, order, x, y, z, &dofs[0]);
+						for (int j=0; j<k; ++j) {
+							for (int i=0; i<k; ++i)
+								B.add_coef(dofs[i], dofs[j], 0.0);
+						}
+					}
+				}
+			}
+			B.freeze_pattern();
+		}
+
+		t0 = now();
+		B.set_zero();
+		for (int z=0; z<num_elements; ++z) {
+			for (int y=0; y<num_elements; ++y) {
+				for (int x=0; x<num_elements; ++x) {
+					int k = hex_element_dofs(n, order, x, y, z, &dofs[0]);
+					for (int j=0; j<k; ++j) {
+						for (int i=0; i<k; ++i)
+							B.add_coef(dofs[i], dofs[j], scale);
+					}
+				}
+			}
+		}
+		B.get_taucs_matrix();
+		t_frozen += now() - t0;
+
+		// precomputed slots (the slot of each element matrix entry)
+		if (iter == 0) {
+			for (int z=0; z<num_elements; ++z) {
+				for (int y=0; y<num_elements; ++y) {
+					for (int x=0; x<num_elements; ++x) {
+						int k = hex_element_dofs(n, order, x, y, z, &dofs[0]);
+						for (int j=0; j<k; ++j) {
+							for (int i=0; i<k; ++i) {
+								if (dofs[i] >= dofs[j])
+									slots.push_back(B.get_slot(dofs[i], dofs[j]));
+							}
+						}
+					}
+				}
+			}
+		}
+
+		t0 = now();
+		B.set_zero();
+		for (std::size_t s=0; s<slots.size(); ++s)
+			B.add_coef_at(slots[s], scale);
+		B.get_taucs_matrix();
+		t_slots += now() - t0;
+	}
+
+	std::cout << "    modifiable pattern:  " << t_modifiable << " s" << std::endl;
+	std::cout << "    frozen pattern:      " << t_frozen << " s" << std::endl;
+	std::cout << "    precomputed slots:   " << t_slots << " s" << std::endl;
+
+	// an element outside the frozen pattern is reported, not dropped silently
+	bool rejected = !B.add_coef(dim - 1, 0, 1.0) && !B.set_coef(dim - 1, 0, 1.0);
+	ParallelAssembler assembler(B, 1);
+	assembler.add_coef(0, dim - 1, 0, 1.0);
+	rejected = rejected && !assembler.finish();
+
+	// same matrices
+	const taucs_ccs_matrix* a = A.get_taucs_matrix();
+	const taucs_ccs_matrix* b = B.get_taucs_matrix();
+	int nnz = a->colptr[dim];
+	return rejected && b->colptr[dim] == nnz &&
+		memcmp(a->rowind, b->rowind, nnz * sizeof(int)) == 0 &&
+		memcmp(a->values.d, b->values.d, nnz * sizeof(double)) == 0;
+}
+
+
+
+// Assemble a matrix with 1, 2, ... threads (and serially), and check that
+// all the matrices are identical.
+static bool benchmark_parallel_assembly(int order, int num_elements, int max_threads) {
+	const int n = num_elements * order + 1;	// nodes per side
+	const int dim = n * n * n * 3;			// 3 dofs per node
+	const int total_elements = num_elements * num_elements * num_elements;
+	const int element_dofs = 3 * (order + 1) * (order + 1) * (order + 1);
+
+	std::cout << "parallel assembly of a " << dim << " x " << dim << " matrix ("
+		<< total_elements << " hexahedral elements of order " << order << ")" << std::endl;
+
+	// serial
+	std::vector<int> dofs(element_dofs);
+	double t0 = now();
+	TaucsMatrix S(dim, dim, false);
+	for (int e=0; e<total_elements; ++e) {
+		int k = hex_element_dofs(n, order, e % num_elements, (e / num_elements) % num_elements, e / (num_elements * num_elements), &dofs[0]);
+		for (int j=0; j<k; ++j) {
+			for (int i=0; i<k; ++i)
+				S.add_coef(dofs[i], dofs[j], 1.0 / (1 + i + j + e % 7));
+		}
+	}
+	const taucs_ccs_matrix* s = S.get_taucs_matrix();
+	double t_serial = now() - t0;
+	std::cout << "    serial:      " << t_serial << " s" << std::endl;
+
+	bool same = true;
+	for (int num_threads=1; num_threads<=max_threads; ++num_threads) {
+		t0 = now();
+		TaucsMatrix P(dim, dim, false);
+		ParallelAssembler assembler(P, num_threads);
+		Parallel::for_each_range(num_threads, 0, total_elements, [&](int thread, int begin, int end) {
+			std::vector<int> dofs(element_dofs);
+			for (int e=begin; e<end; ++e) {
+				int k = hex_element_dofs(n, order, e % num_elements, (e / num_elements) % num_elements, e / (num_elements * num_elements), &dofs[0]);
+				for (int j=0; j<k; ++j) {
+					for (int i=0; i<k; ++i)
+						assembler.add_coef(thread, dofs[i], dofs[j], 1.0 / (1 + i + j + e % 7));
+				}
+			}
+		});
+		assembler.finish();
+		const taucs_ccs_matrix* p = P.get_taucs_matrix();
+		double t = now() - t0;
+		std::cout << "    " << num_threads << " thread(s): " << t << " s (speedup " << t_serial / t << ")" << std::endl;
+
+		int nnz = s->colptr[dim];
+		same = same && p->colptr[dim] == nnz &&
+			memcmp(s->rowind, p->rowind, nnz * sizeof(int)) == 0 &&
+			memcmp(s->values.d, p->values.d, nnz * sizeof(double)) == 0;
+	}
+
+	return same;
+}
+
+
+
+// Hand compressed column arrays produced elsewhere to TaucsMatrix: by replaying
+// every nonzero through add_coef(), and by wrapping the arrays without copy.
+// Then move the TAUCS matrix out of a TaucsMatrix built by set_triplets().
+static bool benchmark_csc_view(int order, int num_elements) {
+	const int n = num_elements * order + 1;	// nodes per side
+	const int dim = n * n * n * 3;			// 3 dofs per node
+
+	// the arrays of the caller
+	std::vector<int> dofs(3 * (order + 1) * (order + 1) * (order + 1));
+	std::vector<int> rows, cols;
+	std::vector<double> values;
+	for (int z=0; z<num_elements; ++z) {
+		for (int y=0; y<num_elements; ++y) {
+			for (int x=0; x<num_elements; ++x) {
+				int k = hex_element_dofs(n, order, x, y, z, &dofs[0]);
+				for (int j=0; j<k; ++j) {
+					for (int i=0; i<k; ++i) {
+						rows.push_back(dofs[i]);
+						cols.push_back(dofs[j]);
+						values.push_back(1.0 / (1 + i + j));
+					}
+				}
+			}
+		}
+	}
+	int nb_triplets = static_cast<int>(values.size());
+	taucs_ccs_matrix* csc = TaucsUtil::CreateTaucsMatrixFromTriplets(dim, dim, nb_triplets,
+		&rows[0], &cols[0], &values[0], TAUCS_DOUBLE | TAUCS_SYMMETRIC | TAUCS_LOWER);
+	int nnz = csc->colptr[dim];
+
+	std::cout << "compressed column arrays of a " << dim << " x " << dim << " symmetric matrix (" << nnz << " nonzeros)" << std::endl;
+
+	// replay
+	double t0 = now();
+	TaucsMatrix A(dim, dim, true);
+	for (int j=0; j<dim; ++j) {
+		for (int k=csc->colptr[j]; k<csc->colptr[j+1]; ++k)
+			A.add_coef(csc->rowind[k], j, csc->values.d[k]);
+	}
+	const taucs_ccs_matrix* a = A.get_taucs_matrix();
+	double t_replay = now() - t0;
+
+	// view
+	t0 = now();
+	TaucsMatrix B(dim, dim, csc->colptr, csc->rowind, csc->values.d, true);
+	const taucs_ccs_matrix* b = B.get_taucs_matrix();
+	double t_view = now() - t0;
+
+	// move out
+	TaucsMatrix C(dim, dim, true);
+	C.set_triplets(nb_triplets, &rows[0], &cols[0], &values[0]);
+	const taucs_ccs_matrix* cached = C.get_taucs_matrix();
+	t0 = now();
+	taucs_ccs_matrix* c = C.release_taucs_matrix();
+	double t_release = now() - t0;
+
+	std::cout << "    add_coef() + get_taucs_matrix(): " << t_replay << " s, " << A.memory_usage() << " bytes" << std::endl;
+	std::cout << "    view + get_taucs_matrix():       " << t_view << " s, " << B.memory_usage() << " bytes" << std::endl;
+	std::cout << "    release_taucs_matrix():          " << t_release << " s" << std::endl;
+
+	bool same = (a->colptr[dim] == nnz) && (b->colptr == csc->colptr) && (c == cached) &&
+		memcmp(a->colptr, csc->colptr, (dim + 1) * sizeof(int)) == 0 &&
+		memcmp(a->rowind, csc->rowind, nnz * sizeof(int)) == 0 &&
+		memcmp(a->values.d, csc->values.d, nnz * sizeof(double)) == 0 &&
+		memcmp(c->rowind, csc->rowind, nnz * sizeof(int)) == 0 &&
+		memcmp(c->values.d, csc->values.d, nnz * sizeof(double)) == 0 &&
+		C.get_coef(0, 0) == 0;
+
+	// writes to the view go to the caller's arrays
+	B.add_coef(0, 0, 1.0);
+	same = same && (csc->values.d[0] == a->values.d[0] + 1.0);
+
+	taucs_ccs_free(c);
+	taucs_ccs_free(csc);
+	return same;
+}
+
+
+
+// Assemble the 3 x 3 block stiffness pattern of a hexahedral mesh with
+// SparseMatrix (scalar by scalar) and with BlockSparseMatrix<3> (block by
+// block), then compare the matrix-vector products.
+static bool benchmark_block_matrix(int num_elements, int num_products) {
+	const int n = num_elements + 1;		// nodes per side
+	const int nb_nodes = n * n * n;
+	const int dim = nb_nodes * 3;		// 3 dofs per node
+
+	std::cout << "block assembly of a " << dim << " x " << dim << " matrix (3 x 3 blocks)" << std::endl;
+
+	// the nodes of an element are its dofs 0, 3, 6, ... divided by 3
+	std::vector<int> dofs(24);
+	double element_block[9];
+
+	double t0 = now();
+	TaucsMatrix A(dim, dim, false);
+	for (int z=0; z<num_elements; ++z) {
+		for (int y=0; y<num_elements; ++y) {
+			for (int x=0; x<num_elements; ++x) {
+				int k = hex_element_dofs(n, 1, x, y, z, &dofs[0]);
+				for (int j=0; j<k; ++j) {
+					for (int i=0; i<k; ++i)
+						A.add_coef(dofs[i], dofs[j], 1.0 / (1 + i + j));
+				}
+			}
+		}
+	}
+	const taucs_ccs_matrix* a = A.get_taucs_matrix();
+	double t_scalar = now() - t0;
+
+	t0 = now();
+	BlockSparseMatrix<3> K(nb_nodes, nb_nodes, false);
+	for (int z=0; z<num_elements; ++z) {
+		for (int y=0; y<num_elements; ++y) {
+			for (int x=0; x<num_elements; ++x) {
+				hex_element_dofs(n, 1, x, y, z, &dofs[0]);
+				for (int bj=0; bj<8; ++bj) {
+					for (int bi=0; bi<8; ++bi) {
+						for (int r=0; r<3; ++r) {
+							for (int c=0; c<3; ++c)
+								element_block[r * 3 + c] = 1.0 / (1 + (bi * 3 + r) + (bj * 3 + c));
+						}
+						K.add_block(dofs[bi * 3] / 3, dofs[bj * 3] / 3, element_block);
+					}
+				}
+			}
+		}
+	}
+	double t_block = now() - t0;
+
+	// products
+	std::vector<double> x(dim), y_scalar(dim), y_block(dim);
+	for (int i=0; i<dim; ++i)
+		x[i] = 1.0 + (i % 7);
+
+	t0 = now();
+	for (int p=0; p<num_products; ++p)
+		TaucsUtil::MulNonSymmMatrixVector(a, &x[0], &y_scalar[0]);
+	double t_scalar_product = now() - t0;
+
+	t0 = now();
+	for (int p=0; p<num_products; ++p)
+		K.multiply(&x[0], &y_block[0]);
+	double t_block_product = now() - t0;
+
+	std::cout << "    assembly:  scalar " << t_scalar << " s (" << A.memory_usage() << " bytes), block "
+		<< t_block << " s (" << K.memory_usage() << " bytes)" << std::endl;
+	std::cout << "    " << num_products << " products: scalar " << t_scalar_product << " s, block " << t_block_product << " s" << std::endl;
+
+	// same products, and same matrix once expanded
+	bool same = true;
+	for (int i=0; i<dim; ++i) {
+		if (std::abs(y_scalar[i] - y_block[i]) > 1e-12 * std::abs(y_scalar[i]))
+			same = false;
+	}
+
+	std::vector<int> colptr, rowind;
+	std::vector<double> values;
+	K.expand(colptr, rowind, values);
+	int nnz = a->colptr[dim];
+	same = same && (colptr[dim] == nnz) &&
+		memcmp(a->colptr, &colptr[0], (dim + 1) * sizeof(int)) == 0 &&
+		memcmp(a->rowind, &rowind[0], nnz * sizeof(int)) == 0 &&
+		memcmp(a->values.d, &values[0], nnz * sizeof(double)) == 0;
+
+	// the symmetric variants too
+	TaucsMatrix S(dim, dim, true);
+	BlockSparseMatrix<3> L(nb_nodes, nb_nodes, true);
+	for (int j=0; j<dim; ++j) {
+		for (int k=a->colptr[j]; k<a->colptr[j+1]; ++k) {
+			S.add_coef(a->rowind[k], j, a->values.d[k]);
+			L.add_coef(a->rowind[k], j, a->values.d[k]);
+		}
+	}
+	const taucs_ccs_matrix* s = S.get_taucs_matrix();
+	L.expand(colptr, rowind, values);
+	nnz = s->colptr[dim];
+	same = same && (colptr[dim] == nnz) &&
+		memcmp(s->colptr, &colptr[0], (dim + 1) * sizeof(int)) == 0 &&
+		memcmp(s->rowind, &rowind[0], nnz * sizeof(int)) == 0 &&
+		memcmp(s->values.d, &values[0], nnz * sizeof(double)) == 0;
+
+	L.multiply(&x[0], &y_block[0]);
+	for (int i=0; i<dim; ++i) {
+		if (std::abs(y_scalar[i] - y_block[i]) > 1e-12 * std::abs(y_scalar[i]))
+			same = false;
+	}
+
+	return same;
+}
+
+
+
+// Solve a 3D Laplacian system for right hand sides arriving one at a time,
+// with TaucsSolver (which factors the matrix for each of them) and with a 
+// TaucsFactorization computed once.
+static bool benchmark_factorization(int n, int num_rhs) {
+	const int size = n * n * n;
+	TaucsMatrix A(size, true);
+	laplacian_3d(n, 1e-2, A);
+
+	std::mt19937 generator(0);
+	std::uniform_real_distribution<double> distribution(-1.0, 1.0);
+	std::vector< std::vector<double> > B(num_rhs, std::vector<double>(size));
+	for (int k=0; k<num_rhs; ++k) {
+		for (int i=0; i<size; ++i)
+			B[k][i] = distribution(generator);
+	}
+
+	std::cout << "3D Laplacian with " << size << " unknowns, " << num_rhs << " right hand sides" << std::endl;
+
+	std::vector< std::vector<double> > X_solver(num_rhs), X_factorization(num_rhs);
+	double t0 = now();
+	for (int k=0; k<num_rhs; ++k) {
+		if (!TaucsSolver::solve_symmetry(A, B[k], X_solver[k]))
+			return false;
+	}
+	double t_solver = now() - t0;
+
+	t0 = now();
+	TaucsFactorization F;
+	if (!F.factor(A, TaucsFactorization::SYMMETRIC))
+		return false;
+	double t_factor = now() - t0;
+	for (int k=0; k<num_rhs; ++k) {
+		if (!F.solve(B[k], X_factorization[k]))
+			return false;
+	}
+	double t_factorization = now() - t0;
+
+	std::cout << "    TaucsSolver::solve_symmetry(): " << t_solver << " s" << std::endl;
+	std::cout << "    TaucsFactorization:            " << t_factorization << " s (factor: " << t_factor << " s)" << std::endl;
+
+	bool ok = true;
+	for (int k=0; k<num_rhs; ++k)
+		ok = ok && (X_solver[k] == X_factorization[k]);
+
+	// refactor after changing the values
+	for (int i=0; i<size; ++i)
+		A.add_coef(i, i, 1.0);
+	std::vector<double> x_refactor, x_solver;
+	ok = ok && F.refactor() && F.solve(B[0], x_refactor) && TaucsSolver::solve_symmetry(A, B[0], x_solver);
+	ok = ok && (x_refactor == x_solver);
+
+	return ok;
+}
+
+
+// Factor a 3D Laplacian matrix whose values change (but not the pattern) 
+// num_factorizations times, analyzing it each time and reusing the analysis.
+static bool benchmark_analysis_reuse(int n, int num_factorizations) {
+	const int size = n * n * n;
+	TaucsMatrix A(size, true);
+	laplacian_3d(n, 1e-2, A);
+
+	std::vector<double> b(size, 1.0);
+	std::cout << "3D Laplacian with " << size << " unknowns, " << num_factorizations << " factorizations" << std::endl;
+
+	// a new analysis for each factorization
+	TaucsFactorization::Statistics statistics;
+	std::vector<double> x_scratch, x_reuse;
+	for (int k=0; k<num_factorizations; ++k) {
+		for (int i=0; i<size; ++i)
+			A.add_coef(i, i, 0.1);
+		TaucsFactorization F;
+		if (!F.factor(A, TaucsFactorization::SYMMETRIC) || !F.solve(b, x_scratch))
+			return false;
+		statistics.nb_analyses += F.statistics().nb_analyses;
+		statistics.analyze_time += F.statistics().analyze_time;
+		statistics.factor_time += F.statistics().factor_time;
+	}
+	std::cout << "    analysis each time: " << statistics.nb_analyses << " analyses " << statistics.analyze_time 
+		<< " s, factorizations " << statistics.factor_time << " s" << std::endl;
+
+	// the same analysis for all the factorizations
+	laplacian_3d(n, 1e-2, A);
+	TaucsFactorization F;
+	for (int k=0; k<num_factorizations; ++k) {
+		for (int i=0; i<size; ++i)
+			A.add_coef(i, i, 0.1);
+		if (!F.factor(A, TaucsFactorization::SYMMETRIC) || !F.solve(b, x_reuse))
+			return false;
+	}
+	std::cout << "    analysis reused:    " << F.statistics().nb_analyses << " analyses " << F.statistics().analyze_time 
+		<< " s, factorizations " << F.statistics().factor_time << " s" << std::endl;
+
+	return (F.statistics().nb_analyses == 1) && (x_scratch == x_reuse);
+}
+
+
+// Solve non-symmetric systems of increasing sizes with the in-core and the
+// out-of-core LU factorizations.
+static bool benchmark_in_core_lu(int min_n, int max_n) {
+	std::cout << "2D convection-diffusion systems" << std::endl;
+	for (int n=min_n; n<=max_n; n*=2) {
+		const int size = n * n;
+		TaucsMatrix A(size, false);
+		convection_diffusion_2d(n, 0.5, A);
+		std::vector<double> b(size, 1.0), x_in_core, x_out_of_core;
+
+		double t0 = now();
+		TaucsFactorization in_core;
+		if (!in_core.factor(A, TaucsFactorization::NON_SYMMETRIC) || !in_core.solve(b, x_in_core))
+			return false;
+		double t_in_core = now() - t0;
+
+		t0 = now();
+		TaucsFactorization out_of_core;
+		out_of_core.set_force_out_of_core(true);
+		if (!out_of_core.factor(A, TaucsFactorization::NON_SYMMETRIC) || !out_of_core.solve(b, x_out_of_core))
+			return false;
+		double t_out_of_core = now() - t0;
+
+		double error = 0, norm = 0;
+		for (int i=0; i<size; ++i) {
+			error = std::max(error, std::fabs(x_in_core[i] - x_out_of_core[i]));
+			norm = std::max(norm, std::fabs(x_out_of_core[i]));
+		}
+
+		// a budget below the predicted factor: out-of-core without trying in-core
+		TaucsFactorization small_budget;
+		small_budget.set_memory_budget(in_core.predicted_factor_size() / 2);
+		if (!small_budget.factor(A, TaucsFactorization::NON_SYMMETRIC))
+			return false;
+
+		std::cout << "    " << size << " unknowns: in-core " << t_in_core << " s, out-of-core " << t_out_of_core 
+			<< " s, relative difference " << error / norm << ", predicted factor " << in_core.predicted_factor_size() 
+			<< " bytes (A: " << A.get_taucs_matrix()->colptr[size] * 12.0 << " bytes)" << std::endl;
+
+		if (!in_core.is_in_core() || out_of_core.is_in_core() || small_budget.is_in_core() || error > 1e-10 * norm)
+			return false;
+	}
+	return true;
+}
+
+
+// Keep num_factorizations out-of-core LU factorizations of different
+// non-symmetric systems at the same time, all with their files in the same
+// scratch directory, and check their solutions.
+static bool benchmark_simultaneous_out_of_core(int n, int num_factorizations, const std::string& directory) {
+	const int size = n * n;
+	std::cout << num_factorizations << " out-of-core factorizations of " << size << " unknowns in \"" << directory << "\"" << std::endl;
+
+	std::vector<TaucsMatrix*> matrices(num_factorizations);
+	std::vector<TaucsFactorization*> factorizations(num_factorizations);
+	for (int k=0; k<num_factorizations; ++k) {
+		// different convections, so that the solutions differ if the files collide
+		matrices[k] = new TaucsMatrix(size, false);
+		convection_diffusion_2d(n, 0.5 * k, *matrices[k]);
+		factorizations[k] = new TaucsFactorization;
+		factorizations[k]->set_force_out_of_core(true);
+		factorizations[k]->set_memory_budget(64 * 1048576.0);
+		factorizations[k]->set_scratch_directory(directory);
+	}
+
+	// factor all, then solve with all
+	bool ok = true;
+	double t0 = now();
+	for (int k=0; k<num_factorizations; ++k)
+		ok = ok && factorizations[k]->factor(*matrices[k], TaucsFactorization::NON_SYMMETRIC);
+	std::vector<double> b(size, 1.0);
+	std::vector< std::vector<double> > results(num_factorizations);
+	for (int k=0; k<num_factorizations; ++k)
+		ok = ok && factorizations[k]->solve(b, results[k]);
+	double t = now() - t0;
+
+	std::cout << "    " << t << " s" << std::endl;
+
+	// compare with the in-core solutions
+	for (int k=0; k<num_factorizations; ++k) {
+		std::vector<double> x;
+		ok = ok && TaucsSolver::solve_non_symmetry(*matrices[k], b, x);
+		double error = 0, norm = 0;
+		for (int i=0; i<size && ok; ++i) {
+			error = std::max(error, std::fabs(x[i] - results[k][i]));
+			norm = std::max(norm, std::fabs(x[i]));
+		}
+		ok = ok && (error <= 1e-10 * norm);
+
+		const TaucsFactorization::Statistics& statistics = factorizations[k]->statistics();
+		std::cout << "    factorization " << k << ": " << statistics.bytes_written << " bytes written, " 
+			<< statistics.bytes_read << " bytes read, " << statistics.io_time << " s of I/O" << std::endl;
+
+		delete factorizations[k];
+		delete matrices[k];
+	}
+
+	return ok;
+}
+
+
+// Factor a 3D Laplacian matrix with each ordering, and let AUTO_ORDERING
+// choose one.
+static bool benchmark_orderings(int n) {
+	const int size = n * n * n;
+	TaucsMatrix A(size, true);
+	laplacian_3d(n, 1e-2, A);
+	std::vector<double> b(size, 1.0), x;
+
+	std::cout << "3D Laplacian with " << size << " unknowns" << std::endl;
+
+	const TaucsFactorization::Ordering orderings[] = {
+		TaucsFactorization::AMD, TaucsFactorization::MMD, TaucsFactorization::GENMMD, 
+		TaucsFactorization::METIS, TaucsFactorization::AUTO_ORDERING
+	};
+	for (int k=0; k<5; ++k) {
+		TaucsFactorization F;
+		F.set_ordering(orderings[k]);
+		if (!F.factor(A, TaucsFactorization::SYMMETRIC) || !F.solve(b, x)) {
+			std::cout << "    " << TaucsFactorization::ordering_name(orderings[k]) << " failed" << std::endl;
+			continue;
+		}
+		std::cout << "    " << TaucsFactorization::ordering_name(orderings[k]) << ": analysis " << F.statistics().analyze_time 
+			<< " s, factorization " << F.statistics().factor_time << " s";
+		if (orderings[k] == TaucsFactorization::AUTO_ORDERING) {
+			std::cout << " (selected " << TaucsFactorization::ordering_name(F.selected_ordering()) << ")" << std::endl;
+			const std::vector<TaucsFactorization::OrderingCandidate>& candidates = F.ordering_candidates();
+			for (std::size_t c=0; c<candidates.size(); ++c) {
+				std::cout << "        " << TaucsFactorization::ordering_name(candidates[c].ordering) << ": nnz(L) " << candidates[c].nnz_L 
+					<< ", flops " << candidates[c].flops << std::endl;
+			}
+			if (candidates.empty())
+				return false;
+		}
+		else
+			std::cout << std::endl;
+	}
+
+	return true;
+}
+
+
+// Solve a 3D Laplacian system (Cholesky) and a 2D convection-diffusion system
+// (in-core LU) for num_rhs right hand sides, one by one and by blocks.
+static bool benchmark_block_solve(int n, int num_rhs) {
+	for (int k=0; k<2; ++k) {
+		const bool symmetric = (k == 0);
+		const int size = symmetric ? n * n * n : n * n * 4;
+		TaucsMatrix A(size, symmetric);
+		if (symmetric)
+			laplacian_3d(n, 1e-2, A);
+		else
+			convection_diffusion_2d(n * 2, 0.5, A);
+
+		TaucsFactorization F;
+		if (!F.factor(A, symmetric ? TaucsFactorization::SYMMETRIC : TaucsFactorization::NON_SYMMETRIC))
+			return false;
+
+		std::vector<double> B(static_cast<std::size_t>(size) * num_rhs), X(B.size()), x;
+		for (std::size_t i=0; i<B.size(); ++i)
+			B[i] = static_cast<double>((i * 7919) % 1000) / 1000.0;
+
+		// one by one
+		double t0 = now();
+		std::vector< std::vector<double> > results(num_rhs);
+		for (int c=0; c<num_rhs; ++c) {
+			std::vector<double> b(B.begin() + static_cast<std::size_t>(c) * size, B.begin() + static_cast<std::size_t>(c + 1) * size);
+			if (!F.solve(b, results[c]))
+				return false;
+		}
+		double t_single = now() - t0;
+
+		// by blocks (the first call also copies the Cholesky factor)
+		t0 = now();
+		if (!F.solve(num_rhs, &B[0], size, &X[0], size))
+			return false;
+		double t_block = now() - t0;
+
+		double error = 0, norm = 0;
+		for (int c=0; c<num_rhs; ++c) {
+			for (int i=0; i<size; ++i) {
+				error = std::max(error, std::fabs(results[c][i] - X[static_cast<std::size_t>(c) * size + i]));
+				norm = std::max(norm, std::fabs(results[c][i]));
+			}
+		}
+
+		std::cout << (symmetric ? "3D Laplacian (Cholesky), " : "2D convection-diffusion (in-core LU), ") << size << " unknowns, " 
+			<< num_rhs << " right hand sides: one by one " << t_single << " s, by blocks " << t_block 
+			<< " s, relative difference " << error / norm << std::endl;
+
+		if (error > 1e-10 * norm)
+			return false;
+	}
+	return true;
+}
+
+
+// Solve a 3D Laplacian system for num_rhs right hand sides with 1 to
+// max_threads threads sharing the factor.
+static bool benchmark_parallel_solve(int n, int num_rhs, int max_threads) {
+	const int size = n * n * n;
+	TaucsMatrix A(size, true);
+	laplacian_3d(n, 1e-2, A);
+
+	std::cout << "3D Laplacian with " << size << " unknowns, " << num_rhs << " right hand sides" << std::endl;
+
+	TaucsFactorization F;
+	if (!F.factor(A, TaucsFactorization::SYMMETRIC))
+		return false;
+
+	std::vector<double> B(static_cast<std::size_t>(size) * num_rhs), X_serial(B.size()), X(B.size());
+	for (std::size_t i=0; i<B.size(); ++i)
+		B[i] = static_cast<double>((i * 7919) % 1000) / 1000.0;
+
+	// once to create the copy of the factor used by the blocked solves
+	F.set_num_threads(1);
+	if (!F.solve(num_rhs, &B[0], size, &X_serial[0], size))
+		return false;
+
+	double t_serial = 0;
+	for (int num_threads=1; num_threads<=max_threads; ++num_threads) {
+		F.set_num_threads(num_threads);
+		double t0 = now();
+		if (!F.solve(num_rhs, &B[0], size, &X[0], size))
+			return false;
+		double t = now() - t0;
+		if (num_threads == 1)
+			t_serial = t;
+		std::cout << "    " << num_threads << " thread(s): " << t << " s (speedup " << t_serial / t << ")" << std::endl;
+
+		if (X != X_serial)
+			return false;
+	}
+	return true;
+}
+
+
+// A random banded least squares matrix: nnz_per_row random elements in a
+// band of 100 columns in each row, one of them on the "diagonal" (so that each
+// column has an element).
+static void random_banded_matrix(int nnz_per_row, TaucsMatrix& A) {
+	const int num_rows = A.row_dimension();
+	const int num_columns = A.column_dimension();
+	std::mt19937 generator(1);
+	const int band = std::min(100, num_columns);
+	for (int r=0; r<num_rows; ++r) {
+		int first = static_cast<int>(static_cast<long long>(r) * (num_columns - band) / num_rows);
+		for (int k=1; k<nnz_per_row; ++k)
+			A.set_coef(r, first + generator() % band, 1.0 + (generator() % 1000) / 1000.0);
+		A.set_coef(r, static_cast<int>(static_cast<long long>(r) * num_columns / num_rows), 2.0);
+	}
+}
+
+
+// A^T*A with one std::map per column of the result, as TaucsUtil computed it
+// before: the reference of benchmark_sparse_product().
+static taucs_ccs_matrix* mul_transpose_with_maps(const taucs_ccs_matrix* At, const taucs_ccs_matrix* A) {
+	int m = At->m;
+	std::vector< std::map<int, double> > cols(m);
+	for (int i=0; i<m; ++i) {
+		for (int pb=A->colptr[i]; pb<A->colptr[i+1]; ++pb) {
+			int r = A->rowind[pb];
+			double b = A->values.d[pb];
+			for (int pa=At->colptr[r]; pa<At->colptr[r+1]; ++pa) {
+				int row = At->rowind[pa];
+				if (row < i)
+					continue;
+				std::map<int, double>::iterator it = cols[i].find(row);
+				if (it == cols[i].end())
+					cols[i][row] = At->values.d[pa] * b;
+				else
+					it->second = it->second + At->values.d[pa] * b;
+			}
+		}
+	}
+	return TaucsUtil::CreateTaucsMatrixFromColumns(cols, m, TAUCS_DOUBLE | TAUCS_SYMMETRIC | TAUCS_LOWER);
+}
+
+
+// Compute A^T*A for a random banded least squares matrix (num_rows x 
+// num_columns, nnz_per_row nonzeros per row) with TaucsUtil and with maps,
+// and check that the results are identical.
+static bool benchmark_sparse_product(int num_rows, int num_columns, int nnz_per_row) {
+	TaucsMatrix A(num_rows, num_columns, false);
+	random_banded_matrix(nnz_per_row, A);
+	const taucs_ccs_matrix* a = A.get_taucs_matrix();
+	taucs_ccs_matrix* at = TaucsUtil::MatrixTranspose(a);
+
+	std::cout << "A^T*A for a " << num_rows << " x " << num_columns << " matrix with " << a->colptr[num_columns] << " nonzeros" << std::endl;
+
+	double t0 = now();
+	taucs_ccs_matrix* reference = mul_transpose_with_maps(at, a);
+	double t_maps = now() - t0;
+
+	t0 = now();
+	taucs_ccs_matrix* AtA = TaucsUtil::Mul2NonSymmMatSymmResult(at, a);
+	double t = now() - t0;
+
+	std::cout << "    std::map: " << t_maps << " s, TaucsUtil (" << Parallel::default_num_threads() << " thread(s)): " 
+		<< t << " s (speedup " << t_maps / t << ")" << std::endl;
+
+	bool same = reference && AtA;
+	if (same) {
+		int nnz = reference->colptr[num_columns];
+		same = AtA->colptr[num_columns] == nnz && AtA->flags == reference->flags &&
+			memcmp(reference->colptr, AtA->colptr, (num_columns + 1) * sizeof(int)) == 0 &&
+			memcmp(reference->rowind, AtA->rowind, nnz * sizeof(int)) == 0 &&
+			memcmp(reference->values.d, AtA->values.d, nnz * sizeof(double)) == 0;
+	}
+
+	taucs_ccs_free(reference);
+	taucs_ccs_free(AtA);
+	taucs_ccs_free(at);
+	return same;
+}
+
+
+// Recompute the normal equations A^T*W*A + lambda*I of a random banded
+// least squares matrix for num_iterations weights and dampings (as in IRLS or
+// Levenberg-Marquardt), compared with forming A^T and A^T*A for each of them.
+static bool benchmark_normal_equations(int num_rows, int num_columns, int nnz_per_row, int num_iterations) {
+	TaucsMatrix A(num_rows, num_columns, false);
+	random_banded_matrix(nnz_per_row, A);
+	const taucs_ccs_matrix* a = A.get_taucs_matrix();
+
+	std::cout << "normal equations of a " << num_rows << " x " << num_columns << " matrix with " << a->colptr[num_columns] << " nonzeros, " 
+		<< num_iterations << " iterations" << std::endl;
+
+	// A^T and A^T*A (unweighted) on each iteration
+	double t0 = now();
+	taucs_ccs_matrix* AtA = NULL;
+	for (int k=0; k<num_iterations; ++k) {
+		taucs_ccs_free(AtA);
+		taucs_ccs_matrix* At = TaucsUtil::MatrixTranspose(a);
+		AtA = TaucsUtil::Mul2NonSymmMatSymmResult(At, a);
+		taucs_ccs_free(At);
+	}
+	double t_transpose = now() - t0;
+
+	// the pattern once, then the values of A^T*W*A + lambda*I
+	NormalEquations N;
+	std::vector<double> weights(num_rows);
+	bool ok = true;
+	t0 = now();
+	ok = ok && N.compute(A);
+	double t_first = now() - t0;
+	for (int k=1; k<num_iterations; ++k) {
+		for (int r=0; r<num_rows; ++r)
+			weights[r] = 1.0 / (1.0 + (r + k) % 10);
+		ok = ok && N.compute(A, &weights[0], 1e-3 * k);
+	}
+	double t_normal = now() - t0;
+
+	std::cout << "    A^T and A^T*A: " << t_transpose << " s, NormalEquations: " << t_normal << " s (first " << t_first 
+		<< " s, speedup " << t_transpose / t_normal << ")" << std::endl;
+
+	// the unweighted product must match A^T*A
+	ok = ok && N.compute(A) && AtA != NULL;
+	if (ok) {
+		const taucs_ccs_matrix* M = N.matrix().get_taucs_matrix();
+		double error = 0, norm = 0;
+		for (int j=0; j<num_columns; ++j) {
+			for (int p=AtA->colptr[j]; p<AtA->colptr[j+1]; ++p) {
+				error = std::max(error, std::fabs(AtA->values.d[p] - N.matrix().get_coef(AtA->rowind[p], j)));
+				norm = std::max(norm, std::fabs(AtA->values.d[p]));
+			}
+		}
+		ok = error <= 1e-12 * norm && M->colptr[num_columns] >= AtA->colptr[num_columns];
+	}
+
+	taucs_ccs_free(AtA);
+	return ok;
+}
+
+
+// Solve a 3D Laplacian system with the Cholesky factorization and with
+// preconditioned conjugate gradients, for each preconditioner.
+static bool benchmark_iterative_symmetry(int n) {
+	const int size = n * n * n;
+	TaucsMatrix A(size, true);
+	laplacian_3d(n, 1e-2, A);
+	std::vector<double> b(size), x_direct;
+	for (int i=0; i<size; ++i)
+		b[i] = 1.0 + (i % 7);
+
+	std::cout << "3D Laplacian with " << size << " unknowns" << std::endl;
+
+	double t0 = now();
+	if (!TaucsSolver::solve_symmetry(A, b, x_direct))
+		return false;
+	std::cout << "    direct: " << now() - t0 << " s" << std::endl;
+
+	const TaucsSolver::Preconditioner preconditioners[] = {
+		TaucsSolver::JACOBI, TaucsSolver::INCOMPLETE_CHOLESKY_0, TaucsSolver::INCOMPLETE_CHOLESKY, TaucsSolver::VAIDYA
+	};
+	const char* names[] = { "Jacobi", "IC(0)", "IC(1e-3)", "Vaidya" };
+
+	bool ok = true;
+	for (int k=0; k<4; ++k) {
+		TaucsSolver::IterativeOptions options;
+		options.preconditioner = preconditioners[k];
+		options.max_iterations = 10000;
+		TaucsSolver::IterativeReport report;
+		std::vector<double> x;
+		t0 = now();
+		bool converged = TaucsSolver::solve_symmetry_iterative(A, b, x, options, &report);
+		double t = now() - t0;
+
+		double error = 0, norm = 0;
+		for (int i=0; i<size && converged; ++i) {
+			error = std::max(error, std::fabs(x[i] - x_direct[i]));
+			norm = std::max(norm, std::fabs(x_direct[i]));
+		}
+		std::cout << "    conjugate gradients (" << names[k] << "): " << t << " s, " << report.iterations 
+			<< " iterations, relative residual " << report.residual;
+		if (converged)
+			std::cout << ", relative difference " << error / norm << std::endl;
+		else
+			std::cout << ", failed" << std::endl;
+
+		ok = ok && converged && error <= 1e-6 * norm;
+	}
+	return ok;
+}
+
+
+// Solve a random banded least squares problem with the normal equations
+// (direct) and with CGLS (iterative), which does not form A^T*A.
+static bool benchmark_iterative_least_squares(int num_rows, int num_columns, int nnz_per_row) {
+	TaucsMatrix A(num_rows, num_columns, false);
+	random_banded_matrix(nnz_per_row, A);
+	std::vector<double> b(num_rows), x_direct, x_iterative;
+	for (int r=0; r<num_rows; ++r)
+		b[r] = 1.0 + (r % 7);
+
+	NormalEquations N;
+	if (!N.compute(A))
+		return false;
+	const double nnz_A = A.get_taucs_matrix()->colptr[num_columns];
+	const double nnz_AtA = N.matrix().get_taucs_matrix()->colptr[num_columns];
+	N.clear();
+
+	std::cout << "least squares with a " << num_rows << " x " << num_columns << " matrix: nnz(A) " << nnz_A 
+		<< ", nnz(A^T*A) " << nnz_AtA << " (" << nnz_AtA * (sizeof(int) + sizeof(double)) / 1048576.0 
+		<< " MB before its factor), CGLS vectors " << 4.0 * (num_rows + num_columns) * sizeof(double) / 1048576.0 << " MB" << std::endl;
+
+	double t0 = now();
+	if (!TaucsSolver::solve_linear_least_square(A, b, x_direct))
+		return false;
+	double t_direct = now() - t0;
+
+	TaucsSolver::IterativeOptions options;
+	options.tolerance = 1e-10;
+	options.max_iterations = 10000;
+	TaucsSolver::IterativeReport report;
+	t0 = now();
+	bool ok = TaucsSolver::solve_linear_least_square_iterative(A, b, x_iterative, options, &report);
+	double t_iterative = now() - t0;
+
+	double error = 0, norm = 0;
+	for (int j=0; j<num_columns; ++j) {
+		error = std::max(error, std::fabs(x_direct[j] - x_iterative[j]));
+		norm = std::max(norm, std::fabs(x_direct[j]));
+	}
+
+	std::cout << "    direct: " << t_direct << " s, CGLS (Jacobi): " << t_iterative << " s, " << report.iterations 
+		<< " iterations, relative residual " << report.residual << ", relative difference " << error / norm << std::endl;
+
+	return ok && error <= 1e-6 * norm;
+}
+
+
+// The KKT matrix [H A^T; A 0] of an equality constrained quadratic problem: H
+// is the 3D Laplacian of an (n x n x n) grid, and each row of A constrains the
+// sum of stride consecutive unknowns. A symmetric K only keeps the lower
+// triangle (set_coef() ignores the upper one).
+static void kkt_matrix(int n, int stride, TaucsMatrix& K) {
+	const int size = n * n * n;
+	for (int z=0; z<n; ++z) {
+		for (int y=0; y<n; ++y) {
+			for (int x=0; x<n; ++x) {
+				int i = x + y * n + z * n * n;
+				K.set_coef(i, i, 6.0);
+				const int neighbors[3] = { x > 0 ? i - 1 : -1, y > 0 ? i - n : -1, z > 0 ? i - n * n : -1 };
+				for (int k=0; k<3; ++k) {
+					if (neighbors[k] >= 0) {
+						K.set_coef(i, neighbors[k], -1.0);
+						K.set_coef(neighbors[k], i, -1.0);
+					}
+				}
+			}
+		}
+	}
+	for (int r=0; r<size/stride; ++r) {
+		for (int k=0; k<stride; ++k) {
+			K.set_coef(size + r, r * stride + k, 1.0);
+			K.set_coef(r * stride + k, size + r, 1.0);
+		}
+	}
+}
+
+
+// Solve a KKT system with the LDL^T factorization of its lower triangle
+// (SYMMETRIC_INDEFINITE) and with the LU factorization of the whole matrix
+// (NON_SYMMETRIC), the only option before.
+static bool benchmark_kkt(int n, int stride) {
+	const int size = n * n * n;
+	const int num_constraints = size / stride;
+	const int dim = size + num_constraints;
+	TaucsMatrix K_symmetric(dim, true), K(dim, false);
+	kkt_matrix(n, stride, K_symmetric);
+	kkt_matrix(n, stride, K);
+
+	std::vector<double> b(dim);
+	std::mt19937 generator(0);
+	std::uniform_real_distribution<double> distribution(-1.0, 1.0);
+	for (int i=0; i<dim; ++i)
+		b[i] = distribution(generator);
+
+	std::cout << "KKT matrix with " << size << " unknowns and " << num_constraints << " constraints: nnz " 
+		<< K_symmetric.get_taucs_matrix()->colptr[dim] << " (lower triangle), " << K.get_taucs_matrix()->colptr[dim] << " (whole)" << std::endl;
+
+	const TaucsFactorization::Mode modes[2] = { TaucsFactorization::SYMMETRIC_INDEFINITE, TaucsFactorization::NON_SYMMETRIC };
+	const char* names[2] = { "LDL^T", "LU   " };
+	bool ok = true;
+	for (int m=0; m<2; ++m) {
+		TaucsFactorization F;
+		std::vector<double> x;
+		if (!F.factor(m == 0 ? K_symmetric : K, modes[m]) || !F.solve(b, x))
+			return false;
+
+		// the residual with the whole matrix
+		std::vector<double> Kx(dim);
+		TaucsUtil::MulNonSymmMatrixVector(K.get_taucs_matrix(), &x[0], &Kx[0]);
+		double residual = 0, norm = 0;
+		for (int i=0; i<dim; ++i) {
+			residual = std::max(residual, std::fabs(Kx[i] - b[i]));
+			norm = std::max(norm, std::fabs(b[i]));
+		}
+
+		const TaucsFactorization::Statistics& statistics = F.statistics();
+		std::cout << "    " << names[m] << ": analysis " << statistics.analyze_time << " s, factorization " << statistics.factor_time 
+			<< " s, solve " << statistics.solve_time << " s, relative residual " << residual / norm;
+		if (modes[m] == TaucsFactorization::SYMMETRIC_INDEFINITE)
+			std::cout << ", " << F.nb_negative_pivots() << " negative pivots (" << F.nb_perturbed_pivots() << " perturbed), backward error " << F.backward_error();
+		std::cout << std::endl;
+
+		ok = ok && residual <= 1e-10 * norm;
+
+		// the inertia: one negative eigenvalue per constraint
+		if (modes[m] == TaucsFactorization::SYMMETRIC_INDEFINITE && F.nb_perturbed_pivots() == 0)
+			ok = ok && F.nb_negative_pivots() == num_constraints;
+	}
+	return ok;
+}
+
+
+// Add and remove soft constraints (weight * x_i = weight * target) on a 3D
+// Laplacian system num_edits times, num_constraints at a time, then couple a
+// few pairs of unknowns, by updating and downdating the Cholesky factor and
+// by refactoring the modified matrix.
+static bool benchmark_cholesky_update(int n, int num_edits, int num_constraints) {
+	const int size = n * n * n;
+	const double weight = 10.0;
+	// A is factored and updated (F refactors A plus the edits when an update
+	// can not be done in place), A_edited is edited and refactored
+	TaucsMatrix A(size, true), A_edited(size, true);
+	laplacian_3d(n, 0.0, A);
+	laplacian_3d(n, 0.0, A_edited);
+	std::vector<double> b(size, 1.0), x_update, x_refactor;
+
+	std::cout << "3D Laplacian with " << size << " unknowns, " << num_edits << " edits of " << num_constraints << " constraints" << std::endl;
+
+	TaucsFactorization F;
+	if (!F.factor(A, TaucsFactorization::SYMMETRIC))
+		return false;
+
+	std::mt19937 generator(0);
+	std::uniform_int_distribution<int> distribution(0, size - 1);
+	std::vector<int> previous;
+	double t_update = 0, t_refactor = 0, error = 0, norm = 0;
+	for (int e=0; e<num_edits; ++e) {
+		// remove the previous constraints, add new ones
+		std::vector<int> constrained(num_constraints);
+		for (int k=0; k<num_constraints; ++k)
+			constrained[k] = distribution(generator);
+
+		TaucsMatrix W_removed(size, num_constraints, false), W_added(size, num_constraints, false);
+		for (int k=0; k<num_constraints; ++k) {
+			if (!previous.empty())
+				W_removed.set_coef(previous[k], k, std::sqrt(weight));
+			W_added.set_coef(constrained[k], k, std::sqrt(weight));
+		}
+
+		double t0 = now();
+		if ((!previous.empty() && !F.downdate(W_removed)) || !F.update(W_added) || !F.solve(b, x_update))
+			return false;
+		t_update += now() - t0;
+
+		// the same edit on the matrix, refactored
+		for (int k=0; k<num_constraints; ++k) {
+			if (!previous.empty())
+				A_edited.add_coef(previous[k], previous[k], -weight);
+			A_edited.add_coef(constrained[k], constrained[k], weight);
+		}
+		t0 = now();
+		TaucsFactorization G;
+		if (!G.factor(A_edited, TaucsFactorization::SYMMETRIC) || !G.solve(b, x_refactor))
+			return false;
+		t_refactor += now() - t0;
+
+		for (int i=0; i<size; ++i) {
+			error = std::max(error, std::fabs(x_update[i] - x_refactor[i]));
+			norm = std::max(norm, std::fabs(x_refactor[i]));
+		}
+		previous.swap(constrained);
+	}
+
+	// Couplings weight * (x_i - x_j)^2 between neighbors (in the pattern of
+	// the factor, or creating fill) and distant unknowns (not in the pattern),
+	// one at a time
+	const int pairs[3][2] = { { 0, 1 }, { size / 2, size / 2 + n * n }, { 1, size - 2 } };
+	double t0 = now();
+	for (int k=0; k<3; ++k) {
+		TaucsMatrix W_pair(size, 1, false);
+		W_pair.set_coef(pairs[k][0], 0, std::sqrt(weight));
+		W_pair.set_coef(pairs[k][1], 0, -std::sqrt(weight));
+		if (!F.update(W_pair))
+			return false;
+	}
+	if (!F.solve(b, x_update))
+		return false;
+	t_update += now() - t0;
+	for (int k=0; k<3; ++k) {
+		A_edited.add_coef(pairs[k][0], pairs[k][0], weight);
+		A_edited.add_coef(pairs[k][1], pairs[k][1], weight);
+		A_edited.add_coef(pairs[k][1], pairs[k][0], -weight);		// lower triangle
+	}
+	t0 = now();
+	TaucsFactorization G;
+	if (!G.factor(A_edited, TaucsFactorization::SYMMETRIC) || !G.solve(b, x_refactor))
+		return false;
+	t_refactor += now() - t0;
+	for (int i=0; i<size; ++i) {
+		error = std::max(error, std::fabs(x_update[i] - x_refactor[i]));
+		norm = std::max(norm, std::fabs(x_refactor[i]));
+	}
+
+	// With the identity ordering, the factor of a small Laplacian is banded and
+	// its elimination tree is a chain: the coupling of 0 and m*m + 1 is on the
+	// path from 0, but out of the pattern of column 0 of the factor (it creates
+	// fill), so the update must refactor.
+	const int m = 6;
+	TaucsMatrix S(m * m * m, true), S_edited(m * m * m, true);
+	laplacian_3d(m, 0.0, S);
+	laplacian_3d(m, 0.0, S_edited);
+	S_edited.add_coef(0, 0, weight);
+	S_edited.add_coef(m * m + 1, m * m + 1, weight);
+	S_edited.add_coef(m * m + 1, 0, -weight);
+	TaucsMatrix W_fill(m * m * m, 1, false);
+	W_fill.set_coef(0, 0, std::sqrt(weight));
+	W_fill.set_coef(m * m + 1, 0, -std::sqrt(weight));
+	std::vector<double> s(m * m * m, 1.0), y_update, y_refactor;
+	TaucsFactorization H, K;
+	H.set_ordering(TaucsFactorization::IDENTITY);
+	if (!H.factor(S, TaucsFactorization::SYMMETRIC) || !H.update(W_fill) || !H.solve(s, y_update) ||
+		!K.factor(S_edited, TaucsFactorization::SYMMETRIC) || !K.solve(s, y_refactor))
+		return false;
+	double fill_error = 0, fill_norm = 0;
+	for (int i=0; i<m * m * m; ++i) {
+		fill_error = std::max(fill_error, std::fabs(y_update[i] - y_refactor[i]));
+		fill_norm = std::max(fill_norm, std::fabs(y_refactor[i]));
+	}
+
+	const TaucsFactorization::Statistics& statistics = F.statistics();
+	std::cout << "    update/downdate: " << t_update << " s (" << statistics.nb_updates << " rank-1 updates in place, " 
+		<< statistics.nb_factorizations - 1 << " refactorizations)" << std::endl;
+	std::cout << "    refactor:        " << t_refactor << " s" << std::endl;
+	std::cout << "    relative difference: " << error / norm << ", with fill: " << fill_error / fill_norm << std::endl;
+
+	return error <= 1e-8 * norm && fill_error <= 1e-8 * fill_norm;
+}
+
+
+// Solve a 3D Laplacian system and a random banded least squares problem in
+// memory and with a memory budget smaller than their predicted Cholesky
+// factor, which switches them to the out-of-core factorization (with its
+// files in directory).
+static bool benchmark_out_of_core_cholesky(int n, int num_rows, int num_columns, const std::string& directory) {
+	const int size = n * n * n;
+	TaucsMatrix A(size, true);
+	laplacian_3d(n, 0.0, A);
+	std::vector<double> b(size, 1.0);
+
+	TaucsMatrix B(num_rows, num_columns, false);
+	random_banded_matrix(8, B);
+	std::vector<double> c(num_rows);
+	for (int r=0; r<num_rows; ++r)
+		c[r] = 1.0 + (r % 7);
+
+	const TaucsFactorization::Mode modes[2] = { TaucsFactorization::SYMMETRIC, TaucsFactorization::LEAST_SQUARES };
+	const char* names[2] = { "3D Laplacian", "least squares" };
+	for (int m=0; m<2; ++m) {
+		const TaucsMatrix& M = (m == 0) ? A : B;
+		const std::vector<double>& rhs = (m == 0) ? b : c;
+		std::vector<double> x_in_core, x_out_of_core;
+
+		double t0 = now();
+		TaucsFactorization in_core;
+		if (!in_core.factor(M, modes[m]) || !in_core.solve(rhs, x_in_core))
+			return false;
+		double t_in_core = now() - t0;
+
+		// a quarter of the predicted factor
+		t0 = now();
+		TaucsFactorization out_of_core;
+		out_of_core.set_memory_budget(in_core.predicted_factor_size() / 4);
+		out_of_core.set_scratch_directory(directory);
+		if (!out_of_core.factor(M, modes[m]) || !out_of_core.solve(rhs, x_out_of_core))
+			return false;
+		double t_out_of_core = now() - t0;
+
+		double error = 0, norm = 0;
+		for (std::size_t i=0; i<x_in_core.size(); ++i) {
+			error = std::max(error, std::fabs(x_in_core[i] - x_out_of_core[i]));
+			norm = std::max(norm, std::fabs(x_in_core[i]));
+		}
+
+		const TaucsFactorization::Statistics& statistics = out_of_core.statistics();
+		std::cout << names[m] << " with " << x_in_core.size() << " unknowns, predicted factor " 
+			<< in_core.predicted_factor_size() / 1048576.0 << " MB, budget " << out_of_core.memory_budget() / 1048576.0 << " MB" << std::endl;
+		std::cout << "    in-core " << t_in_core << " s, out-of-core " << t_out_of_core << " s (" 
+			<< statistics.bytes_written / 1048576.0 << " MB written, " << statistics.bytes_read / 1048576.0 << " MB read, "
+			<< statistics.io_time << " s of I/O), relative difference " << error / norm << std::endl;
+
+		if (!in_core.is_in_core() || out_of_core.is_in_core() || error > 1e-8 * norm)
+			return false;
+	}
+	return true;
+}
+
+
+// Factor a 3D Laplacian system and a random banded least squares problem,
+// save their factorizations to file_name and load them back (as a process
+// would at its start), then check that the file is rejected once the matrix
+// changed.
+static bool benchmark_factorization_file(int n, int num_rows, int num_columns, const std::string& file_name) {
+	const int size = n * n * n;
+	TaucsMatrix A(size, true);
+	laplacian_3d(n, 0.0, A);
+	std::vector<double> b(size, 1.0);
+
+	TaucsMatrix B(num_rows, num_columns, false);
+	random_banded_matrix(8, B);
+	std::vector<double> c(num_rows);
+	for (int r=0; r<num_rows; ++r)
+		c[r] = 1.0 + (r % 7);
+
+	const TaucsFactorization::Mode modes[2] = { TaucsFactorization::SYMMETRIC, TaucsFactorization::LEAST_SQUARES };
+	const char* names[2] = { "3D Laplacian", "least squares" };
+	for (int m=0; m<2; ++m) {
+		TaucsMatrix& M = (m == 0) ? A : B;
+		const std::vector<double>& rhs = (m == 0) ? b : c;
+		std::vector<double> x_factored, x_loaded;
+
+		double t0 = now();
+		TaucsFactorization factored;
+		if (!factored.factor(M, modes[m]) || !factored.solve(rhs, x_factored))
+			return false;
+		double t_factor = now() - t0;
+
+		t0 = now();
+		bool ok = factored.save(file_name);
+		double t_save = now() - t0;
+
+		t0 = now();
+		TaucsFactorization loaded;
+		ok = ok && loaded.load(file_name, M);
+		double t_load = now() - t0;
+		ok = ok && loaded.is_loaded() && loaded.mode() == modes[m] && loaded.solve(rhs, x_loaded);
+
+		double error = 0, norm = 0;
+		for (std::size_t i=0; ok && i<x_factored.size(); ++i) {
+			error = std::max(error, std::fabs(x_factored[i] - x_loaded[i]));
+			norm = std::max(norm, std::fabs(x_factored[i]));
+		}
+
+		// the file is stale once the matrix changed, even if it is saved after
+		// the change (it holds the factor of the previous matrix)
+		M.add_coef(0, 0, 1.0);
+		bool rejected = !loaded.load(file_name, M) && !loaded.is_factored();
+		rejected = rejected && factored.save(file_name) && !loaded.load(file_name, M);
+		M.add_coef(0, 0, -1.0);
+		rejected = rejected && loaded.load(file_name, M);
+
+		std::remove(file_name.c_str());
+
+		std::cout << names[m] << " with " << x_factored.size() << " unknowns" << std::endl;
+		std::cout << "    factor and solve: " << t_factor << " s, save: " << t_save << " s, load: " << t_load << " s" << std::endl;
+		std::cout << "    relative difference: " << error / norm << ", stale file rejected: " << (rejected ? "yes" : "no") << std::endl;
+
+		if (!ok || !rejected || error > 1e-12 * norm)
+			return false;
+	}
+	return true;
+}
+
+
+// Solve a 3D Laplacian system with the double precision factorization and
+// with the single precision one plus iterative refinement.
+static bool benchmark_mixed_precision(int n) {
+	const int size = n * n * n;
+	TaucsMatrix A(size, true);
+	laplacian_3d(n, 1e-2, A);
+
+	std::vector<double> b(size);
+	std::mt19937 generator(0);
+	std::uniform_real_distribution<double> distribution(-1.0, 1.0);
+	for (int i=0; i<size; ++i)
+		b[i] = distribution(generator);
+
+	std::cout << "3D Laplacian with " << size << " unknowns" << std::endl;
+
+	std::vector<double> x_double, x_mixed;
+	double t0 = now();
+	if (!TaucsSolver::solve_symmetry(A, b, x_double))
+		return false;
+	double t_double = now() - t0;
+
+	int iterations = 0;
+	t0 = now();
+	if (!TaucsSolver::solve_symmetry_mixed_precision(A, b, x_mixed, &iterations))
+		return false;
+	double t_mixed = now() - t0;
+
+	double error = 0, norm = 0;
+	for (int i=0; i<size; ++i) {
+		error = std::max(error, std::fabs(x_mixed[i] - x_double[i]));
+		norm = std::max(norm, std::fabs(x_double[i]));
+	}
+
+	std::cout << "    double: " << t_double << " s" << std::endl;
+	std::cout << "    mixed:  " << t_mixed << " s (" << iterations << " refinement iterations)" << std::endl;
+	std::cout << "    relative difference: " << error / norm << std::endl;
+	if (error > 1e-10 * norm)
+		return false;
+
+	// least squares (the residuals of the normal equations use A and A^T)
+	TaucsMatrix B(2 * size, size, false);
+	random_banded_matrix(4, B);
+	std::vector<double> c(2 * size);
+	for (int i=0; i<2*size; ++i)
+		c[i] = distribution(generator);
+
+	std::cout << "least squares with a " << 2 * size << " x " << size << " matrix" << std::endl;
+
+	t0 = now();
+	if (!TaucsSolver::solve_linear_least_square(B, c, x_double))
+		return false;
+	t_double = now() - t0;
+
+	t0 = now();
+	if (!TaucsSolver::solve_linear_least_square_mixed_precision(B, c, x_mixed, &iterations))
+		return false;
+	t_mixed = now() - t0;
+
+	error = 0, norm = 0;
+	for (int i=0; i<size; ++i) {
+		error = std::max(error, std::fabs(x_mixed[i] - x_double[i]));
+		norm = std::max(norm, std::fabs(x_double[i]));
+	}
+
+	std::cout << "    double: " << t_double << " s" << std::endl;
+	std::cout << "    mixed:  " << t_mixed << " s (" << iterations << " refinement iterations)" << std::endl;
+	std::cout << "    relative difference: " << error / norm << std::endl;
+
+	return error <= 1e-8 * norm;
+}
+
+
+// Assemble a matrix with more than 2^31 nonzeros (about 26 GB of memory), 
+// which requires TAUCS_SOLVER_64BIT_OFFSETS. Run only with the --large argument.
+// Assemble a (2^k+1) x (2^k+1) matrix column by column: each column grows to
+// a capacity of 2^(k+1) elements, so that the pool holds about 2^(2k+1) 
+// elements (more than 2^31 for k = 15, i.e., 64-bit offsets) although the
+// matrix has less than 2^31 nonzeros. The exported TAUCS matrix must then be
+// complete and correct.
+static bool benchmark_large_offsets(int k) {
+	const int dim = (1 << k) + 1;
+	const long long pool_size = static_cast<long long>(dim - 1) * (1 << (k + 1)) + dim;
+
+	std::cout << "assembly of a " << dim << " x " << dim << " matrix with a pool of " 
+		<< pool_size << " elements" << std::endl;
+
+	try {
+		double t0 = now();
+		TaucsMatrix A(dim, dim, false);
+		for (int j=0; j<dim; ++j) {
+			for (int i=0; i<dim; ++i)
+				A.add_coef(i, j, (i % 7) + j);
+		}
+		double t = now() - t0;
+
+		std::cout << "    add_coef(): " << t << " s, " << A.memory_usage() << " bytes" << std::endl;
+		bool ok = A.memory_usage() >= pool_size * (sizeof(int) + sizeof(double)) &&
+			A.get_coef(dim - 1, dim - 1) == ((dim - 1) % 7) + (dim - 1);
+
+		t0 = now();
+		const taucs_ccs_matrix* a = A.get_taucs_matrix();
+		t = now() - t0;
+		std::cout << "    get_taucs_matrix(): " << t << " s" << std::endl;
+
+		ok = ok && (a != NULL);
+		for (int j=0; ok && j<=dim; ++j)
+			ok = (a->colptr[j] == static_cast<long long>(j) * dim);
+		for (int j=0; ok && j<dim; ++j) {
+			for (int i=0; ok && i<dim; ++i) {
+				int p = a->colptr[j] + i;
+				ok = (a->rowind[p] == i) && (a->values.d[p] == (i % 7) + j);
+			}
+		}
+		return ok;
+	}
+	catch (const std::exception& e) {
+		std::cout << "    " << e.what() << std::endl;
+		return false;
+	}
+}
+
+
+
+static bool benchmark_large_matrix() {
+	const int rows = 1 << 16;
+	const int cols = (1 << 15) + 1;
+	const long long nnz = static_cast<long long>(rows) * cols;
+
+	std::cout << "assembly of a " << rows << " x " << cols << " matrix with " << nnz << " nonzeros" << std::endl;
+
+	try {
+		double t0 = now();
+		TaucsMatrix A(rows, cols, false);
+		for (int j=0; j<cols; ++j) {
+			for (int i=0; i<rows; ++i)
+				A.add_coef(i, j, (i % 7) + j);
+		}
+		double t = now() - t0;
+
+		std::cout << "    add_coef(): " << t << " s, " << A.memory_usage() << " bytes" << std::endl;
+
+		// elements beyond 2^31
+		bool ok = A.get_coef(rows - 1, cols - 1) == ((rows - 1) % 7) + (cols - 1) &&
+			A.get_coef(12345, cols - 1) == (12345 % 7) + (cols - 1) &&
+			A.get_coef(0, 0) == 0;
+
+		// TAUCS cannot index it
+		ok = ok && (A.get_taucs_matrix() == NULL);
+		return ok;
+	}
+	catch (const std::exception& e) {
+		std::cout << "    " << e.what() << std::endl;
+		return false;
+	}
+}
+
+
+
+int main(int argc, char* argv[])
+{
+	//////////////////////////////////////////////////////////////////////////
+	bool success = benchmark_assembly(1, 16) && benchmark_assembly(2, 8);
+	if (success)
+		std::cout << "assembly benchmark succeeded" << std::endl;
+	else
+		std::cout << "assembly benchmark failed" << std::endl;
+
+	std::cout << std::endl << std::endl << std::endl;
+
+	//////////////////////////////////////////////////////////////////////////
+
+	success = benchmark_out_of_order_assembly();
+	if (success)
+		std::cout << "out of order assembly benchmark succeeded" << std::endl;
+	else
+		std::cout << "out of order assembly benchmark failed" << std::endl;
+
+	std::cout << std::endl << std::endl << std::endl;
+
+	//////////////////////////////////////////////////////////////////////////
+
+	success = benchmark_triplets(1, 16) && benchmark_triplets(2, 8);
+	if (success)
+		std::cout << "triplets benchmark succeeded" << std::endl;
+	else
+		std::cout << "triplets benchmark failed" << std::endl;
+
+	std::cout << std::endl << std::endl << std::endl;
+
+	//////////////////////////////////////////////////////////////////////////
+
+	success = benchmark_frozen_pattern(1, 16, 10);
+	if (success)
+		std::cout << "frozen pattern benchmark succeeded" << std::endl;
+	else
+		std::cout << "frozen pattern benchmark failed" << std::endl;
+
+	std::cout << std::endl << std::endl << std::endl;
+
+	//////////////////////////////////////////////////////////////////////////
+
+	success = benchmark_parallel_assembly(1, 24, Parallel::default_num_threads());
+	if (success)
+		std::cout << "parallel assembly benchmark succeeded" << std::endl;
+	else
+		std::cout << "parallel assembly benchmark failed" << std::endl;
+
+	std::cout << std::endl << std::endl << std::endl;
+
+	//////////////////////////////////////////////////////////////////////////
+
+	success = benchmark_csc_view(1, 16);
+	if (success)
+		std::cout << "csc view benchmark succeeded" << std::endl;
+	else
+		std::cout << "csc view benchmark failed" << std::endl;
+
+	std::cout << std::endl << std::endl << std::endl;
+
+	//////////////////////////////////////////////////////////////////////////
+
+	success = benchmark_block_matrix(24, 20);
+	if (success)
+		std::cout << "block matrix benchmark succeeded" << std::endl;
+	else
+		std::cout << "block matrix benchmark failed" << std::endl;
+
+	std::cout << std::endl << std::endl << std::endl;
+
+	//////////////////////////////////////////////////////////////////////////
+
+	success = benchmark_mixed_precision(40);
+	if (success)
+		std::cout << "mixed precision benchmark succeeded" << std::endl;
+	else
+		std::cout << "mixed precision benchmark failed" << std::endl;
+
+	std::cout << std::endl << std::endl << std::endl;
+
+	//////////////////////////////////////////////////////////////////////////
+
+	success = benchmark_factorization(30, 20);
+	if (success)
+		std::cout << "factorization benchmark succeeded" << std::endl;
+	else
+		std::cout << "factorization benchmark failed" << std::endl;
+
+	std::cout << std::endl << std::endl << std::endl;
+
+	//////////////////////////////////////////////////////////////////////////
+
+	success = benchmark_analysis_reuse(30, 10);
+	if (success)
+		std::cout << "analysis reuse benchmark succeeded" << std::endl;
+	else
+		std::cout << "analysis reuse benchmark failed" << std::endl;
+
+	std::cout << std::endl << std::endl << std::endl;
+
+	//////////////////////////////////////////////////////////////////////////
+
+	success = benchmark_in_core_lu(16, 256);
+	if (success)
+		std::cout << "in-core LU benchmark succeeded" << std::endl;
+	else
+		std::cout << "in-core LU benchmark failed" << std::endl;
+
+	std::cout << std::endl << std::endl << std::endl;
+
+	//////////////////////////////////////////////////////////////////////////
+
+	success = benchmark_simultaneous_out_of_core(64, 4, ".");
+	if (success)
+		std::cout << "simultaneous out-of-core benchmark succeeded" << std::endl;
+	else
+		std::cout << "simultaneous out-of-core benchmark failed" << std::endl;
+
+	std::cout << std::endl << std::endl << std::endl;
+
+	//////////////////////////////////////////////////////////////////////////
+
+	success = benchmark_orderings(30);
+	if (success)
+		std::cout << "orderings benchmark succeeded" << std::endl;
+	else
+		std::cout << "orderings benchmark failed" << std::endl;
+
+	std::cout << std::endl << std::endl << std::endl;
+
+	//////////////////////////////////////////////////////////////////////////
+
+	success = benchmark_block_solve(30, 128);
+	if (success)
+		std::cout << "block solve benchmark succeeded" << std::endl;
+	else
+		std::cout << "block solve benchmark failed" << std::endl;
+
+	std::cout << std::endl << std::endl << std::endl;
+
+	//////////////////////////////////////////////////////////////////////////
+
+	success = benchmark_parallel_solve(20, 1024, Parallel::default_num_threads());
+	if (success)
+		std::cout << "parallel solve benchmark succeeded" << std::endl;
+	else
+		std::cout << "parallel solve benchmark failed" << std::endl;
+
+	std::cout << std::endl << std::endl << std::endl;
+
+	//////////////////////////////////////////////////////////////////////////
+
+	success = benchmark_sparse_product(400000, 100000, 8);
+	if (success)
+		std::cout << "sparse product benchmark succeeded" << std::endl;
+	else
+		std::cout << "sparse product benchmark failed" << std::endl;
+
+	std::cout << std::endl << std::endl << std::endl;
+
+	//////////////////////////////////////////////////////////////////////////
+
+	success = benchmark_normal_equations(400000, 100000, 8, 10);
+	if (success)
+		std::cout << "normal equations benchmark succeeded" << std::endl;
+	else
+		std::cout << "normal equations benchmark failed" << std::endl;
+
+	std::cout << std::endl << std::endl << std::endl;
+
+	//////////////////////////////////////////////////////////////////////////
+
+	success = benchmark_iterative_least_squares(200000, 50000, 8);
+	if (success)
+		std::cout << "iterative least squares benchmark succeeded" << std::endl;
+	else
+		std::cout << "iterative least squares benchmark failed" << std::endl;
+
+	std::cout << std::endl << std::endl << std::endl;
+
+	//////////////////////////////////////////////////////////////////////////
+
+	success = benchmark_iterative_symmetry(40);
+	if (success)
+		std::cout << "iterative symmetric solver benchmark succeeded" << std::endl;
+	else
+		std::cout << "iterative symmetric solver benchmark failed" << std::endl;
+
+	std::cout << std::endl << std::endl << std::endl;
+
+	//////////////////////////////////////////////////////////////////////////
+
+	success = benchmark_kkt(30, 4);
+	if (success)
+		std::cout << "KKT benchmark succeeded" << std::endl;
+	else
+		std::cout << "KKT benchmark failed" << std::endl;
+
+	std::cout << std::endl << std::endl << std::endl;
+
+	//////////////////////////////////////////////////////////////////////////
+
+	success = benchmark_cholesky_update(30, 20, 4);
+	if (success)
+		std::cout << "Cholesky update benchmark succeeded" << std::endl;
+	else
+		std::cout << "Cholesky update benchmark failed" << std::endl;
+
+	std::cout << std::endl << std::endl << std::endl;
+
+	//////////////////////////////////////////////////////////////////////////
+
+	success = benchmark_out_of_core_cholesky(40, 200000, 50000, ".");
+	if (success)
+		std::cout << "out-of-core Cholesky benchmark succeeded" << std::endl;
+	else
+		std::cout << "out-of-core Cholesky benchmark failed" << std::endl;
+
+	std::cout << std::endl << std::endl << std::endl;
+
+	//////////////////////////////////////////////////////////////////////////
+
+	success = benchmark_factorization_file(40, 200000, 50000, "benchmark_taucs.factor");
+	if (success)
+		std::cout << "factorization file benchmark succeeded" << std::endl;
+	else
+		std::cout << "factorization file benchmark failed" << std::endl;
+
+	std::cout << std::endl << std::endl << std::endl;
+
+	//////////////////////////////////////////////////////////////////////////
+
+	if (argc > 1 && strcmp(argv[1], "--large") == 0) {
+#ifdef TAUCS_SOLVER_64BIT_OFFSETS
+		success = benchmark_large_offsets(15);
+		if (success)
+			std::cout << "large offsets benchmark succeeded" << std::endl;
+		else
+			std::cout << "large offsets benchmark failed" << std::endl;
+
+		std::cout << std::endl << std::endl << std::endl;
+
+		//////////////////////////////////////////////////////////////////////////
+
+		success = benchmark_large_matrix();
+		if (success)
+			std::cout << "large matrix benchmark succeeded" << std::endl;
+		else
+			std::cout << "large matrix benchmark failed" << std::endl;
+#else
+		std::cout << "large matrix benchmarks failed: build with TAUCS_SOLVER_64BIT_OFFSETS" << std::endl;
+#endif
+
+		std::cout << std::endl << std::endl << std::endl;
+	}
+
+
+	return 0;
+}
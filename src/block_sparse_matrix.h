@@ -0,0 +1,394 @@
+#ifndef _BLOCK_SPARSE_MATRIX_H_
+#define _BLOCK_SPARSE_MATRIX_H_
+
+// The class BlockSparseMatrix<B> stores a sparse matrix made of dense B x B
+// blocks (block compressed sparse column), e.g., the stiffness matrix of a 3D
+// elasticity problem (B = 3) or of a shell problem (B = 6). Compared with
+// SparseMatrix, it stores one row index per block instead of one per scalar,
+// assembles whole blocks at once, and multiplies vectors block by block.
+//
+// Symmetric matrices store only the lower block triangle, and only the lower
+// triangle of the diagonal blocks is used (like SparseMatrix, the upper
+// triangle is ignored when assembling).
+//
+// The matrix is expanded to scalar compressed column arrays only when it has
+// to be factored:
+//		std::vector<int> colptr, rowind;
+//		std::vector<double> values;
+//		K.expand(colptr, rowind, values);
+//		TaucsMatrix A(K.row_dimension(), K.column_dimension(), &colptr[0], &rowind[0], &values[0], K.is_symmetric());
+//		TaucsSolver::solve_symmetry(A, b, x);
+
+#include <vector>
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <limits>
+
+
+
+// Dot product of two vectors of N elements, unrolled at compile time (the 
+// loops of the block kernels are otherwise not always unrolled).
+template <int N>
+struct BlockDot {
+	static double apply(const double* a, const double* b) { return BlockDot<N - 1>::apply(a, b) + a[N - 1] * b[N - 1]; }
+};
+
+template <>
+struct BlockDot<1> {
+	static double apply(const double* a, const double* b) { return a[0] * b[0]; }
+};
+
+// y <- y + M * x for the first N rows of a B x B block M stored row by row.
+template <int N, int B>
+struct BlockGemv {
+	static void apply(const double* m, const double* x, double* y) {
+		BlockGemv<N - 1, B>::apply(m, x, y);
+		y[N - 1] += BlockDot<B>::apply(m + (N - 1) * B, x);
+	}
+};
+
+template <int B>
+struct BlockGemv<0, B> {
+	static void apply(const double*, const double*, double*) {}
+};
+
+// y <- y + a * x for vectors of N elements.
+template <int N>
+struct BlockAxpy {
+	static void apply(double a, const double* x, double* y) {
+		BlockAxpy<N - 1>::apply(a, x, y);
+		y[N - 1] += a * x[N - 1];
+	}
+};
+
+template <>
+struct BlockAxpy<0> {
+	static void apply(double, const double*, double*) {}
+};
+
+// y <- y + M^T * x for the first N rows of a B x B block M stored row by row.
+template <int N, int B>
+struct BlockGemvTransposed {
+	static void apply(const double* m, const double* x, double* y) {
+		BlockGemvTransposed<N - 1, B>::apply(m, x, y);
+		BlockAxpy<B>::apply(x[N - 1], m + (N - 1) * B, y);
+	}
+};
+
+template <int B>
+struct BlockGemvTransposed<0, B> {
+	static void apply(const double*, const double*, double*) {}
+};
+
+
+
+template <int B>
+class BlockSparseMatrix
+{
+public:
+	enum { BLOCK_SIZE = B };
+
+	/// Create a matrix of block_rows x block_columns blocks initialized with zeros.
+	BlockSparseMatrix(int block_rows, int block_columns, bool is_symmetric = false);
+
+	/// Return the matrix number of (scalar) rows
+	int row_dimension() const    { return m_block_rows * B; }
+	/// Return the matrix number of (scalar) columns
+	int column_dimension() const { return m_block_columns * B; }
+	/// Return the number of block rows/columns
+	int block_row_dimension() const    { return m_block_rows; }
+	int block_column_dimension() const { return m_block_columns; }
+
+	bool is_symmetric() const { return m_is_symmetric; }
+
+	/// Return the number of stored blocks
+	int nb_blocks() const;
+
+	/// Block (bi, bj) <- block (bi, bj) + block, where block is a dense B x B
+	/// matrix stored row by row (block[r * B + c] is the element (r, c)).
+	/// For symmetric matrices, add_block() does nothing if (bi, bj) belongs
+	/// to the upper block triangle, and adds only the lower triangle of
+	/// diagonal blocks.
+	/// Preconditions:
+	/// - 0 <= bi < block_row_dimension().
+	/// - 0 <= bj < block_column_dimension().
+	void add_block(int bi, int bj, const double* block);
+
+	/// Write access to a matrix coefficient: a_ij <- a_ij + val.
+	/// For symmetric matrices, add_coef() does nothing if (i, j) belongs to
+	/// the upper triangle.
+	void add_coef(int i, int j, double val);
+
+	/// Read access to a matrix coefficient.
+	double get_coef(int i, int j) const;
+
+	/// Set all the stored coefficients to zero, keeping the sparsity pattern.
+	void set_zero();
+
+	/// y <- A * x (x and y have column_dimension() and row_dimension() elements).
+	void multiply(const double* x, double* y) const;
+
+	/// Expand the blocks to scalar compressed column arrays (see taucs_ccs_matrix):
+	/// colptr[column_dimension()+1], rowind[nnz] (sorted in each column) and
+	/// values[nnz]. Symmetric matrices give their lower triangle.
+	/// Return false if nnz exceeds 2^31-1 (the arrays are then left unchanged).
+	bool expand(std::vector<int>& colptr, std::vector<int>& rowind, std::vector<double>& values) const;
+
+	/// Return the number of bytes used to store the matrix
+	std::size_t memory_usage() const;
+
+private:
+	// The blocks of a block column, sorted by block row. The values of the
+	// k-th block are m_values[k*B*B .. (k+1)*B*B-1], stored row by row.
+	struct BlockColumn {
+		std::vector<int>	m_indices;
+		std::vector<double>	m_values;
+	};
+
+	// Return the values of block (bi, bj), inserting a zero block if needed
+	double* block(int bi, int bj);
+
+	// Return the position of block row bi in column, or the position where
+	// it should be inserted to keep the block rows sorted.
+	static int lower_bound(const BlockColumn& column, int bi);
+
+private:
+	int		m_block_rows;
+	int		m_block_columns;
+	bool	m_is_symmetric;
+
+	std::vector<BlockColumn>	m_columns;
+}; // class BlockSparseMatrix
+
+
+
+//////////////////////////////////////////////////////////////////////////
+
+
+
+template <int B>
+BlockSparseMatrix<B>::BlockSparseMatrix(int block_rows, int block_columns, bool is_symmetric /* = false*/)
+	: m_block_rows(block_rows)
+	, m_block_columns(block_columns)
+	, m_is_symmetric(is_symmetric)
+	, m_columns(block_columns)
+{
+	assert(block_rows > 0);
+	assert(block_columns > 0);
+	if (is_symmetric) {
+		assert(block_rows == block_columns);
+	}
+}
+
+
+template <int B>
+int BlockSparseMatrix<B>::nb_blocks() const
+{
+	std::size_t nb = 0;
+	for (int bj = 0; bj < m_block_columns; ++bj)
+		nb += m_columns[bj].m_indices.size();
+	return static_cast<int>(nb);
+}
+
+
+template <int B>
+int BlockSparseMatrix<B>::lower_bound(const BlockColumn& column, int bi)
+{
+	const std::vector<int>& indices = column.m_indices;
+
+	// Fast path: appending at the end of the column
+	if (indices.empty() || indices.back() < bi)
+		return static_cast<int>(indices.size());
+
+	return static_cast<int>(std::lower_bound(indices.begin(), indices.end(), bi) - indices.begin());
+}
+
+
+template <int B>
+double* BlockSparseMatrix<B>::block(int bi, int bj)
+{
+	BlockColumn& column = m_columns[bj];
+	int pos = lower_bound(column, bi);
+	if (pos == static_cast<int>(column.m_indices.size()) || column.m_indices[pos] != bi) {
+		column.m_indices.insert(column.m_indices.begin() + pos, bi);
+		column.m_values.insert(column.m_values.begin() + pos * B * B, B * B, 0.0);
+	}
+	return &column.m_values[pos * B * B];
+}
+
+
+template <int B>
+void BlockSparseMatrix<B>::add_block(int bi, int bj, const double* values)
+{
+	if (m_is_symmetric && (bj > bi))
+		return;
+
+	assert(bi < m_block_rows);
+	assert(bj < m_block_columns);
+
+	double* blk = block(bi, bj);
+	if (m_is_symmetric && (bi == bj)) {
+		for (int c = 0; c < B; ++c) {
+			for (int r = c; r < B; ++r)
+				blk[r * B + c] += values[r * B + c];
+		}
+	}
+	else {
+		for (int c = 0; c < B; ++c) {
+			for (int r = 0; r < B; ++r)
+				blk[r * B + c] += values[r * B + c];
+		}
+	}
+}
+
+
+template <int B>
+void BlockSparseMatrix<B>::add_coef(int i, int j, double val)
+{
+	if (m_is_symmetric && (j > i))
+		return;
+
+	assert(i < row_dimension());
+	assert(j < column_dimension());
+
+	block(i / B, j / B)[(i % B) * B + (j % B)] += val;
+}
+
+
+template <int B>
+double BlockSparseMatrix<B>::get_coef(int i, int j) const
+{
+	// For symmetric matrices, we store only the lower triangle
+	// => swap i and j if (i, j) belongs to the upper triangle
+	if (m_is_symmetric && (j > i))
+		std::swap(i, j);
+
+	assert(i < row_dimension());
+	assert(j < column_dimension());
+
+	const BlockColumn& column = m_columns[j / B];
+	int pos = lower_bound(column, i / B);
+	if (pos < static_cast<int>(column.m_indices.size()) && column.m_indices[pos] == i / B)
+		return column.m_values[pos * B * B + (i % B) * B + (j % B)];
+	return 0;
+}
+
+
+template <int B>
+void BlockSparseMatrix<B>::set_zero()
+{
+	for (int bj = 0; bj < m_block_columns; ++bj)
+		std::fill(m_columns[bj].m_values.begin(), m_columns[bj].m_values.end(), 0.0);
+}
+
+
+template <int B>
+void BlockSparseMatrix<B>::multiply(const double* x, double* y) const
+{
+	std::fill(y, y + row_dimension(), 0.0);
+
+	for (int bj = 0; bj < m_block_columns; ++bj) {
+		const BlockColumn& column = m_columns[bj];
+		int nb = static_cast<int>(column.m_indices.size());
+		if (nb == 0)
+			continue;
+		const int* indices = &column.m_indices[0];
+		const double* blk = &column.m_values[0];
+
+		// Local copies, which the compiler can keep in registers
+		double xj[B], yj[B];
+		for (int c = 0; c < B; ++c) {
+			xj[c] = x[bj * B + c];
+			yj[c] = 0;
+		}
+
+		int k = 0;
+		if (m_is_symmetric && indices[0] == bj) {
+			// Diagonal block: only its lower triangle is used
+			for (int c = 0; c < B; ++c) {
+				yj[c] += blk[c * B + c] * xj[c];
+				for (int r = c + 1; r < B; ++r) {
+					yj[r] += blk[r * B + c] * xj[c];
+					yj[c] += blk[r * B + c] * xj[r];
+				}
+			}
+			k = 1;
+			blk += B * B;
+		}
+
+		if (!m_is_symmetric) {
+			for (; k < nb; ++k, blk += B * B)
+				BlockGemv<B, B>::apply(blk, xj, y + indices[k] * B);
+		}
+		else {
+			for (; k < nb; ++k, blk += B * B) {
+				BlockGemv<B, B>::apply(blk, xj, y + indices[k] * B);
+				// The transposed block (upper block triangle)
+				BlockGemvTransposed<B, B>::apply(blk, x + indices[k] * B, yj);
+			}
+		}
+
+		for (int c = 0; c < B; ++c)
+			y[bj * B + c] += yj[c];
+	}
+}
+
+
+template <int B>
+bool BlockSparseMatrix<B>::expand(std::vector<int>& colptr, std::vector<int>& rowind, std::vector<double>& values) const
+{
+	// Symmetric matrices do not store the upper triangle of the diagonal blocks
+	std::size_t nnz = 0;
+	for (int bj = 0; bj < m_block_columns; ++bj) {
+		const BlockColumn& column = m_columns[bj];
+		nnz += column.m_indices.size() * B * B;
+		if (m_is_symmetric && !column.m_indices.empty() && column.m_indices[0] == bj)
+			nnz -= B * (B - 1) / 2;
+	}
+
+	// The arrays are indexed with int, as in TAUCS
+	if (nnz > static_cast<std::size_t>(std::numeric_limits<int>::max()))
+		return false;
+
+	colptr.resize(column_dimension() + 1);
+	rowind.resize(nnz);
+	values.resize(nnz);
+
+	// The scalar column bj*B + c is made of the column c of the blocks of
+	// the block column bj, in the order of the block rows.
+	int k = 0;
+	colptr[0] = 0;
+	for (int bj = 0; bj < m_block_columns; ++bj) {
+		const BlockColumn& column = m_columns[bj];
+		for (int c = 0; c < B; ++c) {
+			for (std::size_t b = 0; b < column.m_indices.size(); ++b) {
+				int bi = column.m_indices[b];
+				const double* blk = &column.m_values[b * B * B + c];
+				int first = (m_is_symmetric && bi == bj) ? c : 0;
+				for (int r = first; r < B; ++r) {
+					rowind[k] = bi * B + r;
+					values[k] = blk[r * B];
+					++k;
+				}
+			}
+			colptr[bj * B + c + 1] = k;
+		}
+	}
+
+	assert(k == static_cast<int>(nnz));
+	return true;
+}
+
+
+template <int B>
+std::size_t BlockSparseMatrix<B>::memory_usage() const
+{
+	std::size_t size = sizeof(BlockSparseMatrix) + m_columns.capacity() * sizeof(BlockColumn);
+	for (int bj = 0; bj < m_block_columns; ++bj)
+		size += m_columns[bj].m_indices.capacity() * sizeof(int) + m_columns[bj].m_values.capacity() * sizeof(double);
+	return size;
+}
+
+
+#endif // _BLOCK_SPARSE_MATRIX_H_
@@ -0,0 +1,117 @@
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+
+MappedFile::MappedFile()
+	: m_data(NULL)
+	, m_size(0)
+#ifdef _WIN32
+	, m_file(NULL)
+	, m_mapping(NULL)
+#endif
+{
+}
+
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+
+#ifdef _WIN32
+
+bool MappedFile::open(const std::string& file_name)
+{
+	close();
+
+	HANDLE file = CreateFileA(file_name.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+		CloseHandle(file);
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping == NULL) {
+		CloseHandle(file);
+		return false;
+	}
+
+	void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (data == NULL) {
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	m_file = file;
+	m_mapping = mapping;
+	m_data = static_cast<const char*>(data);
+	m_size = static_cast<std::size_t>(size.QuadPart);
+	return true;
+}
+
+
+void MappedFile::close()
+{
+	if (m_data != NULL) {
+		UnmapViewOfFile(m_data);
+		CloseHandle(m_mapping);
+		CloseHandle(m_file);
+	}
+	m_data = NULL;
+	m_size = 0;
+	m_file = NULL;
+	m_mapping = NULL;
+}
+
+#else
+
+bool MappedFile::open(const std::string& file_name)
+{
+	close();
+
+	int fd = ::open(file_name.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat status;
+	if (fstat(fd, &status) != 0 || status.st_size == 0) {
+		::close(fd);
+		return false;
+	}
+
+	// the mapping stays valid after the file is closed
+	void* data = mmap(NULL, static_cast<std::size_t>(status.st_size), PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (data == MAP_FAILED)
+		return false;
+
+	m_data = static_cast<const char*>(data);
+	m_size = static_cast<std::size_t>(status.st_size);
+	return true;
+}
+
+
+void MappedFile::close()
+{
+	if (m_data != NULL)
+		munmap(const_cast<char*>(m_data), m_size);
+	m_data = NULL;
+	m_size = 0;
+}
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef _MAPPED_FILE_H_
+#define _MAPPED_FILE_H_
+
+// The class MappedFile maps a file read-only into memory (mmap, or
+// MapViewOfFile on Windows). The pages are loaded on demand and shared by all
+// the processes that map the same file, so that opening a large file costs
+// almost nothing until its contents are read.
+
+#include <string>
+#include <cstddef>
+
+
+class MappedFile
+{
+public:
+	MappedFile();
+
+	/// Unmap the file
+	~MappedFile();
+
+	/// Map the file read-only. The previous file is unmapped first.
+	/// Return false if the file can not be opened or mapped (or is empty).
+	bool open(const std::string& file_name);
+
+	/// Unmap the file
+	void close();
+
+	bool is_open() const { return m_data != NULL; }
+
+	/// The contents of the file, valid until close()
+	const char* data() const { return m_data; }
+	std::size_t size() const { return m_size; }
+
+private:
+	// Not copyable (the mapping cannot be shared)
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+
+private:
+	const char*		m_data;
+	std::size_t		m_size;
+#ifdef _WIN32
+	void*			m_file;
+	void*			m_mapping;
+#endif
+};
+
+
+#endif // _MAPPED_FILE_H_
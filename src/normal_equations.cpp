@@ -0,0 +1,240 @@
+#include "normal_equations.h"
+#include "taucs_matrix.h"
+#include "parallel.h"
+
+#include <iostream>
+#include <algorithm>
+#include <limits>
+
+
+#define  TAUCS_CORE_DOUBLE
+extern "C" {
+#include <taucs.h>
+}
+
+
+NormalEquations::NormalEquations()
+	: m_matrix(NULL)
+{
+}
+
+
+NormalEquations::~NormalEquations()
+{
+	clear();
+}
+
+
+bool NormalEquations::compute(const TaucsMatrix& matrix, const double* weights, double lambda, const double* damping)
+{
+	const taucs_ccs_matrix* A = matrix.get_taucs_matrix();
+	if (A == NULL) {
+		std::cout << title() << "can not create the TAUCS matrix" << std::endl;
+		return false;
+	}
+
+	if ((A->flags & TAUCS_SYMMETRIC) || A->m < A->n) {
+		std::cout << title() << "A is symmetric or num_row < num_col" << std::endl;
+		return false;
+	}
+
+	if (m_matrix == NULL || !same_pattern(A)) {
+		if (!analyze(A)) {
+			clear();
+			return false;
+		}
+	}
+
+	m_A_values.assign(A->taucs_values, A->taucs_values + A->colptr[A->n]);
+	if (weights != NULL)
+		m_weights.assign(weights, weights + A->m);
+	else
+		m_weights.assign(A->m, 1.0);
+
+	// column i of M: the elements (r, i) of A, each one times row r of A from
+	// column i on (the lower triangle)
+	int n = A->n;
+	int num_threads = std::max(1, std::min(Parallel::default_num_threads(), n));
+	Parallel::for_each_range(num_threads, 0, n, [&](int, int begin, int end) {
+		std::vector<int> position(n);		// the position in column i of M of each row
+		for (int i = begin; i < end; ++i) {
+			for (int p = m_colptr[i]; p < m_colptr[i + 1]; ++p) {
+				position[m_rowind[p]] = p;
+				m_values[p] = 0;
+			}
+
+			for (int q = A->colptr[i]; q < A->colptr[i + 1]; ++q) {
+				int r = A->rowind[q];
+				double a = m_A_values[q] * m_weights[r];
+				for (int rp = m_row_index[q]; rp < m_row_ptr[r + 1]; ++rp)
+					m_values[position[m_row_col[rp]]] += a * m_A_values[m_row_val[rp]];
+			}
+
+			// the diagonal comes first in the column
+			m_values[m_colptr[i]] += lambda * (damping != NULL ? damping[i] : 1.0);
+		}
+	});
+
+	return true;
+}
+
+
+bool NormalEquations::set_transpose(const TaucsMatrix& matrix, const double* weights)
+{
+	clear();
+
+	const taucs_ccs_matrix* A = matrix.get_taucs_matrix();
+	if (A == NULL) {
+		std::cout << title() << "can not create the TAUCS matrix" << std::endl;
+		return false;
+	}
+
+	if ((A->flags & TAUCS_SYMMETRIC) || A->m < A->n) {
+		std::cout << title() << "A is symmetric or num_row < num_col" << std::endl;
+		return false;
+	}
+
+	int nnz = A->colptr[A->n];
+	m_A_colptr.assign(A->colptr, A->colptr + A->n + 1);
+	m_A_rowind.assign(A->rowind, A->rowind + nnz);
+	m_A_values.assign(A->taucs_values, A->taucs_values + nnz);
+	if (weights != NULL)
+		m_weights.assign(weights, weights + A->m);
+	else
+		m_weights.assign(A->m, 1.0);
+	return true;
+}
+
+
+void NormalEquations::multiply_transpose(const double* b, double* Atb) const
+{
+	int n = static_cast<int>(m_A_colptr.size()) - 1;
+	for (int i = 0; i < n; ++i) {
+		double sum = 0;
+		for (int q = m_A_colptr[i]; q < m_A_colptr[i + 1]; ++q) {
+			int r = m_A_rowind[q];
+			sum += m_A_values[q] * m_weights[r] * b[r];
+		}
+		Atb[i] = sum;
+	}
+}
+
+
+void NormalEquations::clear()
+{
+	delete m_matrix;
+	m_matrix = NULL;
+
+	std::vector<int>().swap(m_A_colptr);
+	std::vector<int>().swap(m_A_rowind);
+	std::vector<int>().swap(m_row_ptr);
+	std::vector<int>().swap(m_row_col);
+	std::vector<int>().swap(m_row_val);
+	std::vector<int>().swap(m_row_index);
+	std::vector<int>().swap(m_colptr);
+	std::vector<int>().swap(m_rowind);
+	std::vector<double>().swap(m_values);
+	std::vector<double>().swap(m_A_values);
+	std::vector<double>().swap(m_weights);
+}
+
+
+bool NormalEquations::same_pattern(const taucs_ccs_matrix* A) const
+{
+	if (static_cast<int>(m_A_colptr.size()) != A->n + 1 || static_cast<int>(m_row_ptr.size()) != A->m + 1)
+		return false;
+	int nnz = A->colptr[A->n];
+	return std::equal(A->colptr, A->colptr + A->n + 1, m_A_colptr.begin()) &&
+		std::equal(A->rowind, A->rowind + nnz, m_A_rowind.begin());
+}
+
+
+bool NormalEquations::analyze(const taucs_ccs_matrix* A)
+{
+	delete m_matrix;
+	m_matrix = NULL;
+
+	int m = A->m;
+	int n = A->n;
+	int nnz = A->colptr[n];
+	m_A_colptr.assign(A->colptr, A->colptr + n + 1);
+	m_A_rowind.assign(A->rowind, A->rowind + nnz);
+
+	// the rows of A (counting sort of the elements by row, in column order)
+	m_row_ptr.assign(m + 1, 0);
+	for (int q = 0; q < nnz; ++q)
+		++m_row_ptr[A->rowind[q] + 1];
+	for (int r = 0; r < m; ++r)
+		m_row_ptr[r + 1] += m_row_ptr[r];
+	m_row_col.resize(nnz);
+	m_row_val.resize(nnz);
+	m_row_index.resize(nnz);
+	std::vector<int> next(m_row_ptr.begin(), m_row_ptr.end() - 1);
+	for (int i = 0; i < n; ++i) {
+		for (int q = A->colptr[i]; q < A->colptr[i + 1]; ++q) {
+			int rp = next[A->rowind[q]]++;
+			m_row_col[rp] = i;
+			m_row_val[rp] = q;
+			m_row_index[q] = rp;
+		}
+	}
+
+	// the pattern of M, in two passes: the number of nonzeros of each column,
+	// then the rows
+	int num_threads = std::max(1, std::min(Parallel::default_num_threads(), n));
+	m_colptr.assign(n + 1, 0);
+	Parallel::for_each_range(num_threads, 0, n, [&](int, int begin, int end) {
+		std::vector<int> mark(n, -1);
+		for (int i = begin; i < end; ++i) {
+			mark[i] = i;
+			int count = 1;		// the diagonal
+			for (int q = A->colptr[i]; q < A->colptr[i + 1]; ++q) {
+				int r = A->rowind[q];
+				for (int rp = m_row_index[q]; rp < m_row_ptr[r + 1]; ++rp) {
+					int j = m_row_col[rp];
+					if (mark[j] != i) {
+						mark[j] = i;
+						++count;
+					}
+				}
+			}
+			m_colptr[i + 1] = count;
+		}
+	});
+
+	std::size_t count = 0;
+	for (int i = 0; i < n; ++i) {
+		count += m_colptr[i + 1];
+		if (count > static_cast<std::size_t>(std::numeric_limits<int>::max())) {
+			std::cout << title() << "A^T * A has more than 2^31-1 nonzeros" << std::endl;
+			return false;
+		}
+		m_colptr[i + 1] = static_cast<int>(count);
+	}
+
+	m_rowind.resize(count);
+	m_values.assign(count, 0.0);
+	Parallel::for_each_range(num_threads, 0, n, [&](int, int begin, int end) {
+		std::vector<int> mark(n, -1);
+		for (int i = begin; i < end; ++i) {
+			int* rows = &m_rowind[0] + m_colptr[i];
+			int k = 0;
+			mark[i] = i;
+			rows[k++] = i;
+			for (int q = A->colptr[i]; q < A->colptr[i + 1]; ++q) {
+				int r = A->rowind[q];
+				for (int rp = m_row_index[q]; rp < m_row_ptr[r + 1]; ++rp) {
+					int j = m_row_col[rp];
+					if (mark[j] != i) {
+						mark[j] = i;
+						rows[k++] = j;
+					}
+				}
+			}
+			std::sort(rows + 1, rows + k);
+		}
+	});
+
+	m_matrix = new TaucsMatrix(n, n, &m_colptr[0], &m_rowind[0], &m_values[0], true);
+	return true;
+}
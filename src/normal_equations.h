@@ -0,0 +1,117 @@
+#ifndef _NORMAL_EQUATIONS_H_
+#define _NORMAL_EQUATIONS_H_
+
+// The class NormalEquations computes the matrix of the weighted and damped
+// normal equations of a least squares problem min ||W^(1/2) (A*x - b)||:
+//		M = A^T*W*A + lambda*D
+// with W and D diagonal, directly from the compressed columns of A (A^T is not
+// formed). The pattern of M (lower triangle, plus the diagonal) is computed
+// once for the pattern of A; compute() then only evaluates the values, so that
+// the loops in which W and lambda change (IRLS, Levenberg-Marquardt) refresh M
+// in place. Both phases run in parallel over the columns of M.
+//
+// M is returned as a symmetric TaucsMatrix whose pattern does not change,
+// hence TaucsFactorization::refactor() reuses the analysis of M.
+//
+// Usage:
+//		NormalEquations N;
+//		N.compute(A, &w[0], lambda);
+//		N.multiply_transpose(&b[0], &Atb[0]);
+//		TaucsFactorization F;
+//		F.factor(N.matrix(), TaucsFactorization::SYMMETRIC);
+//		F.solve(Atb, x);
+//		while (...) {
+//			... change w and lambda ...
+//			N.compute(A, &w[0], lambda);
+//			N.multiply_transpose(&b[0], &Atb[0]);
+//			F.refactor();
+//			F.solve(Atb, x);
+//		}
+
+#include <vector>
+#include <string>
+
+
+class TaucsMatrix;
+struct taucs_ccs_matrix;
+
+class NormalEquations
+{
+public:
+	static std::string title() { return "[NormalEquations]: "; }
+
+	NormalEquations();
+	~NormalEquations();
+
+	/// Compute M = A^T*W*A + lambda*D for the m x n matrix A (m >= n, not
+	/// symmetric).
+	/// weights: the m diagonal elements of W (NULL for the identity).
+	/// damping: the n diagonal elements of D (NULL for the identity).
+	/// The pattern of M is computed again only if the pattern of A changed
+	/// since the previous call.
+	/// Return false if A is symmetric or has more columns than rows, or if M
+	/// has more than 2^31-1 nonzeros.
+	bool compute(const TaucsMatrix& A, const double* weights = NULL, double lambda = 0, const double* damping = NULL);
+
+	/// Keep A and the weights for multiply_transpose() only, without computing
+	/// M (e.g., when the factor of M is already available): M and the patterns
+	/// are released, until the next call to compute().
+	/// Return false if A is symmetric or has more columns than rows.
+	bool set_transpose(const TaucsMatrix& A, const double* weights = NULL);
+
+	/// Compute Atb = A^T*W*b with the matrix and the weights of the last call
+	/// to compute() or set_transpose(). b has A.row_dimension() elements, Atb
+	/// A.column_dimension().
+	void multiply_transpose(const double* b, double* Atb) const;
+
+	/// Return true if M was computed by the last call to compute() (false after
+	/// set_transpose())
+	bool is_computed() const { return m_matrix != NULL; }
+
+	/// Return M, valid until the next call to compute() (and the same object
+	/// as long as the pattern of A does not change).
+	/// Precondition: compute() succeeded.
+	const TaucsMatrix& matrix() const { return *m_matrix; }
+
+	/// Release M and the patterns
+	void clear();
+
+private:
+	// Not copyable (m_matrix wraps the arrays of this object)
+	NormalEquations(const NormalEquations&);
+	NormalEquations& operator=(const NormalEquations&);
+
+	// Return true if A has the pattern of the last analysis
+	bool same_pattern(const taucs_ccs_matrix* A) const;
+
+	// Compute the rows of A and the pattern of M
+	bool analyze(const taucs_ccs_matrix* A);
+
+private:
+	// The pattern of A of the analysis
+	std::vector<int>	m_A_colptr;
+	std::vector<int>	m_A_rowind;
+
+	// The rows of A: the columns (increasing) of the elements of row r are
+	// m_row_col[m_row_ptr[r] .. m_row_ptr[r+1]-1], and the elements are
+	// m_row_val[...] in the values of A. The element p of A (in column order)
+	// is m_row_index[p] in the rows.
+	std::vector<int>	m_row_ptr;
+	std::vector<int>	m_row_col;
+	std::vector<int>	m_row_val;
+	std::vector<int>	m_row_index;
+
+	// M (lower triangle), wrapped by m_matrix
+	std::vector<int>	m_colptr;
+	std::vector<int>	m_rowind;
+	std::vector<double>	m_values;
+	TaucsMatrix*		m_matrix;
+
+	// The values of A and the weights of the last call to compute() (or
+	// set_transpose())
+	std::vector<double>	m_A_values;
+	std::vector<double>	m_weights;
+};
+
+
+#endif // _NORMAL_EQUATIONS_H_
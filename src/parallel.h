@@ -0,0 +1,46 @@
+#ifndef _PARALLEL_H_
+#define _PARALLEL_H_
+
+// Minimal helpers to run loops on several threads (std::thread).
+
+#include <thread>
+#include <vector>
+
+
+namespace Parallel {
+
+	// The number of threads used by default: the number of hardware threads.
+	inline int default_num_threads() {
+		unsigned int n = std::thread::hardware_concurrency();
+		return (n > 0) ? static_cast<int>(n) : 1;
+	}
+
+	// Call func(thread) for thread = 0 .. num_threads-1, each on its own thread
+	// (thread 0 runs on the calling thread), and wait for all of them.
+	template <class Function>
+	void run(int num_threads, Function func) {
+		std::vector<std::thread> threads;
+		for (int t = 1; t < num_threads; ++t)
+			threads.push_back(std::thread(func, t));
+		func(0);
+		for (std::size_t t = 0; t < threads.size(); ++t)
+			threads[t].join();
+	}
+
+	// Split [begin, end) into num_threads contiguous ranges of (almost) the same
+	// size, and call func(thread, range_begin, range_end) for each of them in
+	// parallel. Thread t gets the t-th range, so the ranges follow the order of
+	// the threads.
+	template <class Function>
+	void for_each_range(int num_threads, int begin, int end, Function func) {
+		run(num_threads, [&](int t) {
+			long long size = end - begin;
+			int range_begin = begin + static_cast<int>(size * t / num_threads);
+			int range_end   = begin + static_cast<int>(size * (t + 1) / num_threads);
+			func(t, range_begin, range_end);
+		});
+	}
+}
+
+
+#endif // _PARALLEL_H_
@@ -0,0 +1,193 @@
+#include "parallel_assembler.h"
+#include "sparse_matrix.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+
+
+
+ParallelAssembler::ParallelAssembler(SparseMatrix& A, int num_threads)
+	: m_matrix(A)
+	, m_buffers(num_threads > 0 ? num_threads : 1)
+{
+}
+
+
+void ParallelAssembler::add_coef(int thread, int i, int j, double val)
+{
+	if (m_matrix.m_is_symmetric && (j > i))
+		return;
+
+	assert(thread < num_threads());
+	assert(i < m_matrix.m_row_dimension);
+	assert(j < m_matrix.m_column_dimension);
+
+	Entry entry = { i, j, val };
+	m_buffers[thread].push_back(entry);
+}
+
+
+int ParallelAssembler::owner(int j) const
+{
+	// The columns are split into num_threads() contiguous ranges
+	return static_cast<int>(static_cast<long long>(j) * num_threads() / m_matrix.m_column_dimension);
+}
+
+
+int ParallelAssembler::owner_begin_column(int o) const
+{
+	// The first column j such that owner(j) >= o
+	long long n = m_matrix.m_column_dimension;
+	return static_cast<int>((o * n + num_threads() - 1) / num_threads());
+}
+
+
+bool ParallelAssembler::finish()
+{
+	int nb_threads = num_threads();
+
+	// The elements stored by TaucsMatrix::set_triplets() go to the columns, 
+	// which can receive new elements
+	if (m_matrix.has_compressed_arrays() && !m_matrix.is_pattern_frozen())
+		m_matrix.unfreeze_pattern();
+
+	// Bucket the contributions of each thread by owner (stable counting sort).
+	// After that, the contributions of thread t to the columns of owner o are
+	// order[t][owner_begin[t][o] .. owner_begin[t][o+1]-1].
+	std::vector< std::vector<int> > owner_begin(nb_threads);
+	std::vector< std::vector<int> > order(nb_threads);
+	Parallel::run(nb_threads, [&](int t) {
+		const Buffer& entries = m_buffers[t];
+		int size = entries.size;
+
+		std::vector<int>& begin = owner_begin[t];
+		begin.assign(nb_threads + 1, 0);
+		if (nb_threads == 1) {
+			begin[1] = size;
+			return;		// no need to reorder
+		}
+
+		for (int k = 0; k < size; ++k)
+			++begin[owner(entries[k].col) + 1];
+		for (int o = 0; o < nb_threads; ++o)
+			begin[o + 1] += begin[o];
+
+		std::vector<int> next(begin.begin(), begin.end() - 1);
+		order[t].resize(size);
+		for (int k = 0; k < size; ++k)
+			order[t][next[owner(entries[k].col)]++] = k;
+	});
+
+	// Each thread applies the contributions to the columns it owns, and 
+	// records what it did to them
+	std::vector<int> inserted(nb_threads, 0);
+	std::vector<int> changed(nb_threads, 0);
+	std::vector<long long> rejected(nb_threads, 0);
+	if (m_matrix.is_pattern_frozen()) {
+		Parallel::run(nb_threads, [&](int o) {
+			for (int t = 0; t < nb_threads; ++t) {
+				const Buffer& entries = m_buffers[t];
+				for (int p = owner_begin[t][o]; p < owner_begin[t][o + 1]; ++p) {
+					const Entry& entry = entries[(nb_threads == 1) ? p : order[t][p]];
+					int slot = m_matrix.get_slot(entry.row, entry.col);
+					if (slot >= 0) {
+						m_matrix.m_frozen_values[slot] += entry.value;
+						changed[o] = 1;
+					}
+					else
+						++rejected[o];		// cannot insert into a frozen pattern
+				}
+			}
+		});
+	}
+	else {
+		// The columns share the pool of the matrix, which cannot grow from
+		// several threads. So each thread merges its columns into its own
+		// arrays, which are then concatenated into a new pool.
+		int nb_columns = m_matrix.m_column_dimension;
+		std::vector<SparseOffset> colptr(nb_columns + 1, 0);
+		std::vector< std::vector<int> >		part_indices(nb_threads);
+		std::vector< std::vector<double> >	part_values(nb_threads);
+		Parallel::run(nb_threads, [&](int o) {
+			int col_begin = owner_begin_column(o);
+			int col_end   = owner_begin_column(o + 1);
+
+			// The contributions to the columns of o, by column and in order
+			std::vector<int> count(col_end - col_begin + 1, 0);
+			for (int t = 0; t < nb_threads; ++t) {
+				const Buffer& entries = m_buffers[t];
+				for (int p = owner_begin[t][o]; p < owner_begin[t][o + 1]; ++p)
+					++count[entries[(nb_threads == 1) ? p : order[t][p]].col - col_begin + 1];
+			}
+			for (int j = col_begin; j < col_end; ++j)
+				count[j - col_begin + 1] += count[j - col_begin];
+			std::vector<const Entry*> column_entries(count.back());
+			for (int t = 0; t < nb_threads; ++t) {
+				const Buffer& entries = m_buffers[t];
+				for (int p = owner_begin[t][o]; p < owner_begin[t][o + 1]; ++p) {
+					const Entry& entry = entries[(nb_threads == 1) ? p : order[t][p]];
+					column_entries[count[entry.col - col_begin]++] = &entry;
+				}
+			}
+
+			// Merge them into a copy of each column
+			std::vector<int>&		indices = part_indices[o];
+			std::vector<double>&	values  = part_values[o];
+			ColumnPool	scratch_pool;
+			int			first = 0;
+			for (int j = col_begin; j < col_end; ++j) {
+				const Column& column = m_matrix.m_columns[j];
+				int last = count[j - col_begin];
+
+				Column scratch;
+				scratch_pool.clear(&scratch, 1, false);
+				scratch_pool.assign(scratch, m_matrix.m_pool.indices(column), m_matrix.m_pool.values(column), column.dimension());
+				for (int p = first; p < last; ++p) {
+					Column::Change change = scratch.add_coef(scratch_pool, column_entries[p]->row, column_entries[p]->value);
+					if (change == Column::INSERTED)
+						inserted[o] = 1;
+					else if (change == Column::VALUE_CHANGED)
+						changed[o] = 1;
+				}
+				first = last;
+
+				indices.insert(indices.end(), scratch_pool.indices(scratch), scratch_pool.indices(scratch) + scratch.dimension());
+				values.insert(values.end(), scratch_pool.values(scratch), scratch_pool.values(scratch) + scratch.dimension());
+				colptr[j + 1] = scratch.dimension();
+			}
+		});
+
+		// Concatenate the parts into the pool of the matrix
+		for (int j = 0; j < nb_columns; ++j)
+			colptr[j + 1] += colptr[j];
+		int*    indices = ColumnPool::allocate<int>(colptr[nb_columns]);
+		double* values  = ColumnPool::allocate<double>(colptr[nb_columns]);
+		Parallel::run(nb_threads, [&](int o) {
+			SparseOffset offset = colptr[owner_begin_column(o)];
+			std::copy(part_indices[o].begin(), part_indices[o].end(), indices + offset);
+			std::copy(part_values[o].begin(), part_values[o].end(), values + offset);
+		});
+		m_matrix.m_pool.adopt(m_matrix.m_columns, nb_columns, &colptr[0], indices, values);
+	}
+
+	// Update the modification counters of the matrix
+	if (std::find(inserted.begin(), inserted.end(), 1) != inserted.end())
+		++m_matrix.m_pattern_version;
+	if (std::find(changed.begin(), changed.end(), 1) != changed.end())
+		++m_matrix.m_values_version;
+
+	// Clear the buffers (keeping their memory for the next assembly)
+	for (int t = 0; t < nb_threads; ++t)
+		m_buffers[t].size = 0;
+
+	long long nb_rejected = 0;
+	for (int o = 0; o < nb_threads; ++o)
+		nb_rejected += rejected[o];
+	if (nb_rejected > 0) {
+		std::cout << title() << nb_rejected << " contributions do not belong to the frozen pattern" << std::endl;
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,101 @@
+#ifndef _PARALLEL_ASSEMBLER_H_
+#define _PARALLEL_ASSEMBLER_H_
+
+// The class ParallelAssembler allows several threads to add contributions
+// (e.g., element matrices of a FEM mesh) to a SparseMatrix concurrently.
+//
+// Each thread appends its contributions to its own buffer (no locking), and
+// finish() merges the buffers into the matrix in parallel: each thread owns a
+// range of columns and applies, in order, all the contributions to its columns
+// (into its own arrays, which are then concatenated into the pool of the matrix).
+//
+// The result is identical to calling A.add_coef() serially for all the
+// contributions of thread 0, then all those of thread 1, and so on. Hence,
+// splitting a loop into contiguous ranges in the order of the threads (e.g.,
+// with Parallel::for_each_range()) gives exactly the same matrix as the serial
+// loop, including the rounding of the sums.
+//
+// Usage:
+//		ParallelAssembler assembler(A, num_threads);
+//		Parallel::for_each_range(num_threads, 0, num_elements, [&](int thread, int begin, int end) {
+//			for (int e = begin; e < end; ++e)
+//				... assembler.add_coef(thread, i, j, val); ...
+//		});
+//		assembler.finish();
+
+#include <vector>
+#include <string>
+
+
+class SparseMatrix;
+
+class ParallelAssembler
+{
+public:
+	static std::string title() { return "[ParallelAssembler]: "; }
+
+	/// Prepare the assembly into A with num_threads threads.
+	ParallelAssembler(SparseMatrix& A, int num_threads);
+
+	/// Return the number of threads
+	int num_threads() const { return static_cast<int>(m_buffers.size()); }
+
+	/// a_ij <- a_ij + val, when finish() is called.
+	/// Different threads can call add_coef() concurrently, provided each of
+	/// them uses its own thread index.
+	/// For symmetric matrices, add_coef() does nothing if (i, j) belongs to
+	/// the upper triangle.
+	/// Preconditions:
+	/// - 0 <= thread < num_threads().
+	/// - 0 <= i < row_dimension().
+	/// - 0 <= j < column_dimension().
+	void add_coef(int thread, int i, int j, double val);
+
+	/// Add all the contributions to the matrix (using num_threads() threads)
+	/// and clear the buffers. The assembler can then be used again.
+	/// Return false if the pattern of the matrix is frozen and some 
+	/// contributions do not belong to it (they are not added).
+	bool finish();
+
+private:
+	// A contribution a_ij <- a_ij + value
+	struct Entry {
+		int		row;
+		int		col;
+		double	value;
+	};
+
+	// The contributions of one thread, stored in fixed-size chunks (which,
+	// unlike a single vector, are never copied when the buffer grows).
+	// Padded to avoid false sharing between the threads.
+	struct Buffer {
+		enum { CHUNK_BITS = 16, CHUNK_SIZE = 1 << CHUNK_BITS };
+
+		Buffer() : size(0) {}
+
+		void push_back(const Entry& entry) {
+			if ((size >> CHUNK_BITS) == static_cast<int>(chunks.size()))
+				chunks.push_back(std::vector<Entry>(CHUNK_SIZE));
+			chunks[size >> CHUNK_BITS][size & (CHUNK_SIZE - 1)] = entry;
+			++size;
+		}
+		const Entry& operator[](int k) const { return chunks[k >> CHUNK_BITS][k & (CHUNK_SIZE - 1)]; }
+
+		std::vector< std::vector<Entry> >	chunks;
+		int									size;
+		char								padding[64];
+	};
+
+	// The owner of column j
+	int owner(int j) const;
+
+	// The first column owned by o (or the number of columns if o == num_threads())
+	int owner_begin_column(int o) const;
+
+private:
+	SparseMatrix&			m_matrix;
+	std::vector<Buffer>		m_buffers;
+};
+
+
+#endif // _PARALLEL_ASSEMBLER_H_
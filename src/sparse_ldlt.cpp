@@ -0,0 +1,362 @@
+#include "sparse_ldlt.h"
+
+#include <cmath>
+#include <cfloat>
+#include <limits>
+#include <algorithm>
+
+
+#define  TAUCS_CORE_DOUBLE
+extern "C" {
+#include <taucs.h>
+}
+
+
+bool SparseLDLT::analyze(const taucs_ccs_matrix* A, const int* perm)
+{
+	clear();
+
+	int n = A->n;
+	int nnz = A->colptr[n];
+
+	m_perm.resize(n);
+	m_pinv.resize(n);
+	for (int k = 0; k < n; ++k) {
+		m_perm[k] = (perm != NULL) ? perm[k] : k;
+		m_pinv[m_perm[k]] = k;
+	}
+
+	// C = P*A*P^T: element (i, j) of the lower triangle of A goes to column
+	// max(pinv[i], pinv[j]) of the upper triangle of C (counting sort)
+	m_C_colptr.assign(n + 1, 0);
+	for (int j = 0; j < n; ++j) {
+		for (int p = A->colptr[j]; p < A->colptr[j + 1]; ++p)
+			++m_C_colptr[std::max(m_pinv[A->rowind[p]], m_pinv[j]) + 1];
+	}
+	for (int k = 0; k < n; ++k)
+		m_C_colptr[k + 1] += m_C_colptr[k];
+
+	m_C_indices.resize(nnz);
+	m_C_values.resize(nnz);
+	m_C_map.resize(nnz);
+	std::vector<int> next(m_C_colptr.begin(), m_C_colptr.end() - 1);
+	for (int j = 0; j < n; ++j) {
+		for (int p = A->colptr[j]; p < A->colptr[j + 1]; ++p) {
+			int pi = m_pinv[A->rowind[p]];
+			int pj = m_pinv[j];
+			int q = next[std::max(pi, pj)]++;
+			m_C_indices[q] = std::min(pi, pj);
+			m_C_map[p] = q;
+		}
+	}
+
+	// The elimination tree and the number of nonzeros of each column of L:
+	// row k of L is the set of the nodes on the paths from the rows of
+	// column k of C up to k in the tree
+	m_parent.assign(n, -1);
+	std::vector<int> flag(n);
+	std::vector<int> count(n, 0);
+	for (int k = 0; k < n; ++k) {
+		flag[k] = k;
+		for (int p = m_C_colptr[k]; p < m_C_colptr[k + 1]; ++p) {
+			for (int i = m_C_indices[p]; flag[i] != k; i = m_parent[i]) {
+				if (m_parent[i] == -1)
+					m_parent[i] = k;
+				++count[i];
+				flag[i] = k;
+			}
+		}
+	}
+
+	m_L_colptr.resize(n + 1);
+	std::size_t total = 0;
+	for (int j = 0; j < n; ++j) {
+		m_L_colptr[j] = static_cast<int>(total);
+		total += count[j];
+		if (total > static_cast<std::size_t>(std::numeric_limits<int>::max())) {
+			clear();
+			return false;
+		}
+	}
+	m_L_colptr[n] = static_cast<int>(total);
+	m_L_indices.resize(total);
+
+	m_n = n;
+	return true;
+}
+
+
+bool SparseLDLT::factor(const taucs_ccs_matrix* A, double pivot_tolerance)
+{
+	clear_factor();
+
+	int n = m_n;
+	int nnz = A->colptr[n];
+
+	// The values of C, its largest element and its norm
+	for (int p = 0; p < nnz; ++p)
+		m_C_values[m_C_map[p]] = A->taucs_values[p];
+
+	double largest = 0;
+	std::vector<double> row_sum(n, 0.0);
+	for (int j = 0; j < n; ++j) {
+		for (int p = m_C_colptr[j]; p < m_C_colptr[j + 1]; ++p) {
+			int i = m_C_indices[p];
+			double a = std::fabs(m_C_values[p]);
+			largest = std::max(largest, a);
+			row_sum[i] += a;
+			if (i != j)
+				row_sum[j] += a;
+		}
+	}
+	m_C_norm = (n > 0) ? *std::max_element(row_sum.begin(), row_sum.end()) : 0;
+	if (!(largest > 0))
+		return false;		// zero (or not a number)
+
+	double tau = pivot_tolerance * largest;
+
+	m_L_values.resize(m_L_indices.size());
+	m_D.resize(n);
+
+	std::vector<double> y(n, 0.0);	// row k of L*D, scattered
+	std::vector<int> pattern(n);	// the nonzeros of row k of L (in pattern[top .. n-1])
+	std::vector<int> flag(n);
+	std::vector<int> count(n);		// the number of nonzeros computed so far in each column of L
+
+	for (int k = 0; k < n; ++k) {
+		// the pattern of row k of L, in topological order, and y = C(0:k, k)
+		int top = n;
+		flag[k] = k;
+		count[k] = 0;
+		for (int p = m_C_colptr[k]; p < m_C_colptr[k + 1]; ++p) {
+			int i = m_C_indices[p];
+			y[i] += m_C_values[p];
+			int len = 0;
+			for (; flag[i] != k; i = m_parent[i]) {
+				pattern[len++] = i;
+				flag[i] = k;
+			}
+			while (len > 0)
+				pattern[--top] = pattern[--len];
+		}
+
+		// solve for row k of L, and compute the pivot
+		double d = y[k];
+		y[k] = 0;
+		for (; top < n; ++top) {
+			int i = pattern[top];
+			double yi = y[i];
+			y[i] = 0;
+			int end = m_L_colptr[i] + count[i];
+			for (int p = m_L_colptr[i]; p < end; ++p)
+				y[m_L_indices[p]] -= m_L_values[p] * yi;
+			double l = yi / m_D[i];
+			d -= l * yi;
+			m_L_indices[end] = k;
+			m_L_values[end] = l;
+			++count[i];
+		}
+
+		if (d != d || std::fabs(d) == std::numeric_limits<double>::infinity()) {
+			clear_factor();
+			return false;
+		}
+		if (std::fabs(d) < tau) {
+			d = (d < 0) ? -tau : tau;
+			++m_nb_perturbed;
+		}
+		if (d < 0)
+			++m_nb_negative;
+		m_D[k] = d;
+	}
+
+	m_factored = true;
+	return true;
+}
+
+
+const double SparseLDLT::MAX_BACKWARD_ERROR = std::sqrt(DBL_EPSILON);
+
+
+bool SparseLDLT::solve(const double* b, double* x, double* backward_error) const
+{
+	return solve(1, b, m_n, x, m_n, backward_error);
+}
+
+
+bool SparseLDLT::solve(int nrhs, const double* B, int ldb, double* X, int ldx, double* backward_error) const
+{
+	int n = m_n;
+
+	// The block of right hand sides in the permuted order, by rows (see
+	// solve_block()), its solution and its residual, and the best solution
+	// of the refinement
+	std::size_t size = static_cast<std::size_t>(n) * std::min<int>(nrhs, BLOCK_SIZE);
+	std::vector<double> PB(size), W(size), R, best_W;
+	std::vector<double> best_error;
+	if (m_nb_perturbed > 0) {
+		R.resize(size);
+		best_W.resize(size);
+	}
+	double largest_error = 0;
+
+	for (int first = 0; first < nrhs; first += BLOCK_SIZE) {
+		std::size_t nb = std::min<int>(nrhs - first, BLOCK_SIZE);
+
+		// PB = P*B
+		for (std::size_t c = 0; c < nb; ++c) {
+			const double* b = B + (first + c) * static_cast<std::size_t>(ldb);
+			for (int k = 0; k < n; ++k)
+				PB[k * nb + c] = b[m_perm[k]];
+		}
+
+		std::copy(PB.begin(), PB.begin() + n * nb, W.begin());
+		solve_block(&W[0], nb);
+
+		// Iterative refinement, until the backward error is at the precision
+		// of the machine or stops decreasing: W = W + (L*D*L^T) \ (P*B - C*W).
+		// The iterate with the smallest backward error is kept for each vector.
+		if (m_nb_perturbed > 0) {
+			best_error.assign(nb, 0.0);
+			double previous = std::numeric_limits<double>::max();
+			for (int step = 0; ; ++step) {
+				std::copy(PB.begin(), PB.begin() + n * nb, R.begin());
+				subtract_product(&W[0], &R[0], nb);
+
+				double error = 0;
+				for (std::size_t c = 0; c < nb; ++c) {
+					double r = 0, w = 0, b = 0;
+					for (int k = 0; k < n; ++k) {
+						r = std::max(r, std::fabs(R[k * nb + c]));
+						w = std::max(w, std::fabs(W[k * nb + c]));
+						b = std::max(b, std::fabs(PB[k * nb + c]));
+					}
+					double e = (r > 0) ? r / (m_C_norm * w + b) : 0;
+					if (step == 0 || e < best_error[c]) {
+						best_error[c] = e;
+						for (int k = 0; k < n; ++k)
+							best_W[k * nb + c] = W[k * nb + c];
+					}
+					error = std::max(error, e);
+				}
+				if (error <= DBL_EPSILON || error > 0.5 * previous || step == MAX_REFINEMENT_STEPS)
+					break;
+				previous = error;
+
+				solve_block(&R[0], nb);
+				for (std::size_t i = 0; i < n * nb; ++i)
+					W[i] += R[i];
+			}
+
+			W.swap(best_W);
+			for (std::size_t c = 0; c < nb; ++c) {
+				if (!(best_error[c] <= largest_error))
+					largest_error = best_error[c];		// including a NaN
+			}
+		}
+
+		// X = P^T*W
+		for (std::size_t c = 0; c < nb; ++c) {
+			double* x = X + (first + c) * static_cast<std::size_t>(ldx);
+			for (int k = 0; k < n; ++k)
+				x[m_perm[k]] = W[k * nb + c];
+		}
+	}
+
+	if (backward_error != NULL)
+		*backward_error = largest_error;
+	return largest_error <= MAX_BACKWARD_ERROR;
+}
+
+
+void SparseLDLT::solve_block(double* W, std::size_t nb) const
+{
+	int n = m_n;
+
+	// W = L \ W
+	for (int j = 0; j < n; ++j) {
+		const double* wj = W + j * nb;
+		for (int p = m_L_colptr[j]; p < m_L_colptr[j + 1]; ++p) {
+			double l = m_L_values[p];
+			double* wi = W + m_L_indices[p] * nb;
+			for (std::size_t c = 0; c < nb; ++c)
+				wi[c] -= l * wj[c];
+		}
+	}
+
+	// W = D \ W
+	for (int j = 0; j < n; ++j) {
+		double* wj = W + j * nb;
+		double d = m_D[j];
+		for (std::size_t c = 0; c < nb; ++c)
+			wj[c] /= d;
+	}
+
+	// W = L^T \ W
+	for (int j = n - 1; j >= 0; --j) {
+		double* wj = W + j * nb;
+		for (int p = m_L_colptr[j]; p < m_L_colptr[j + 1]; ++p) {
+			double l = m_L_values[p];
+			const double* wi = W + m_L_indices[p] * nb;
+			for (std::size_t c = 0; c < nb; ++c)
+				wj[c] -= l * wi[c];
+		}
+	}
+}
+
+
+void SparseLDLT::subtract_product(const double* W, double* R, std::size_t nb) const
+{
+	// each element (i, j) of the upper triangle is also (j, i)
+	for (int j = 0; j < m_n; ++j) {
+		const double* wj = W + j * nb;
+		double* rj = R + j * nb;
+		for (int p = m_C_colptr[j]; p < m_C_colptr[j + 1]; ++p) {
+			int i = m_C_indices[p];
+			double a = m_C_values[p];
+			const double* wi = W + i * nb;
+			double* ri = R + i * nb;
+			for (std::size_t c = 0; c < nb; ++c)
+				ri[c] -= a * wj[c];
+			if (i != j) {
+				for (std::size_t c = 0; c < nb; ++c)
+					rj[c] -= a * wi[c];
+			}
+		}
+	}
+}
+
+
+void SparseLDLT::clear_factor()
+{
+	std::vector<double>().swap(m_L_values);
+	std::vector<double>().swap(m_D);
+	m_factored = false;
+	m_nb_perturbed = 0;
+	m_nb_negative = 0;
+}
+
+
+void SparseLDLT::clear()
+{
+	clear_factor();
+
+	m_n = 0;
+	std::vector<int>().swap(m_perm);
+	std::vector<int>().swap(m_pinv);
+	std::vector<int>().swap(m_C_colptr);
+	std::vector<int>().swap(m_C_indices);
+	std::vector<double>().swap(m_C_values);
+	std::vector<int>().swap(m_C_map);
+	std::vector<int>().swap(m_parent);
+	std::vector<int>().swap(m_L_colptr);
+	std::vector<int>().swap(m_L_indices);
+}
+
+
+std::size_t SparseLDLT::memory_usage() const
+{
+	return (m_perm.capacity() + m_pinv.capacity() + m_C_colptr.capacity() + m_C_indices.capacity() + m_C_map.capacity() +
+		m_parent.capacity() + m_L_colptr.capacity() + m_L_indices.capacity()) * sizeof(int) +
+		(m_C_values.capacity() + m_L_values.capacity() + m_D.capacity()) * sizeof(double);
+}
@@ -0,0 +1,132 @@
+#ifndef _SPARSE_LDLT_H_
+#define _SPARSE_LDLT_H_
+
+// The class SparseLDLT is a sparse LDL^T factorization of a symmetric
+// indefinite TAUCS matrix (lower triangle stored), e.g., the KKT matrix
+// [H A^T; A 0] of a constrained problem, which the Cholesky factorization
+// rejects. For a given symmetric ordering P: P*A*P^T = L*D*L^T, with L unit
+// lower triangular and D diagonal. L has the pattern of the Cholesky factor,
+// hence half the storage and about half the operations of the LU factor.
+//
+// The analysis (elimination tree and pattern of L) depends only on the
+// pattern of A; factor() can be called again for new values. The
+// factorization is up-looking: row k of L is computed by a sparse triangular
+// solve with the rows above it.
+//
+// There is no pivoting across the ordering: a pivot smaller in magnitude than
+// pivot_tolerance * max|a_ij| (e.g., on the zero block of a KKT matrix) is
+// replaced by this value, with its sign (static pivoting). If some pivots
+// were perturbed, solve() corrects the solution by iterative refinement with
+// A.
+
+#include <vector>
+#include <cstddef>
+
+
+struct taucs_ccs_matrix;
+
+class SparseLDLT
+{
+public:
+	SparseLDLT() : m_n(0), m_C_norm(0), m_factored(false), m_nb_perturbed(0), m_nb_negative(0) {}
+
+	/// Analyze the symmetric matrix A (lower triangle) for the ordering perm
+	/// (NULL for the identity): row and column perm[k] of A is eliminated at
+	/// step k. The previous analysis and factor are released first.
+	/// Return false if L would have more than 2^31-1 nonzeros.
+	bool analyze(const taucs_ccs_matrix* A, const int* perm);
+
+	/// Factor A, which has the pattern given to analyze() (the values may
+	/// differ). The previous factor is released first.
+	/// pivot_tolerance: relative to the largest element of A (see above).
+	/// Return false if A is zero or a pivot is not finite.
+	bool factor(const taucs_ccs_matrix* A, double pivot_tolerance = 1e-8);
+
+	/// solve for "A*x=b" with the factor. x and b can be the same array.
+	/// If pivots were perturbed, x is the refined iterate with the smallest
+	/// backward error max|b - A*x| / (||A|| * max|x| + max|b|), returned in
+	/// backward_error if not NULL (0 if no pivot was perturbed).
+	/// Return false if this error exceeds MAX_BACKWARD_ERROR, i.e., the
+	/// refinement did not converge: x is then inaccurate.
+	bool solve(const double* b, double* x, double* backward_error = NULL) const;
+
+	/// solve for "A*X=B" with the factor, for nrhs right hand sides stored by
+	/// columns: column c of B (X) starts at B + c*ldb (X + c*ldx). The factor
+	/// is traversed once for each block of BLOCK_SIZE right hand sides.
+	/// X and B can be the same array. backward_error is the largest one of
+	/// the columns of X (see above).
+	bool solve(int nrhs, const double* B, int ldb, double* X, int ldx, double* backward_error = NULL) const;
+
+	enum { BLOCK_SIZE = 32 };
+
+	/// The maximum number of steps of iterative refinement of solve()
+	enum { MAX_REFINEMENT_STEPS = 10 };
+
+	/// The largest backward error of an accurate solve() (the square root of
+	/// the machine precision)
+	static const double MAX_BACKWARD_ERROR;
+
+	bool is_analyzed() const { return m_n > 0; }
+
+	/// Return true if a factor is available for solve()
+	bool is_factored() const { return m_factored; }
+
+	/// The number of pivots replaced by the static pivoting
+	int nb_perturbed_pivots() const { return m_nb_perturbed; }
+
+	/// The number of negative pivots, i.e., of negative eigenvalues of A if
+	/// no pivot was perturbed (e.g., the number of constraints of a KKT
+	/// matrix whose Hessian is positive definite on their null space)
+	int nb_negative_pivots() const { return m_nb_negative; }
+
+	/// Release the factor (the analysis is kept)
+	void clear_factor();
+
+	/// Release the factor and the analysis
+	void clear();
+
+	/// Return the number of nonzeros of L (without its unit diagonal)
+	std::size_t nnz() const { return m_L_indices.size(); }
+
+	/// Return the number of bytes used to store the factor
+	std::size_t memory_usage() const;
+
+private:
+	// Solve L*D*L^T*W = W for the nb vectors of W in the permuted order, stored
+	// by rows (the nb values of row i are contiguous)
+	void solve_block(double* W, std::size_t nb) const;
+
+	// R = R - C*W, for the nb vectors of W stored by rows
+	void subtract_product(const double* W, double* R, std::size_t nb) const;
+
+private:
+	int					m_n;
+
+	// m_pinv[i] is the step of row (and column) i of A, m_perm[k] the row of A
+	// at step k
+	std::vector<int>	m_perm;
+	std::vector<int>	m_pinv;
+
+	// C = P*A*P^T, upper triangle in compressed columns (the rows are not
+	// sorted). The element p of A is m_C_values[m_C_map[p]].
+	std::vector<int>	m_C_colptr;
+	std::vector<int>	m_C_indices;
+	std::vector<double>	m_C_values;
+	std::vector<int>	m_C_map;
+	double				m_C_norm;		// the largest row sum of |C|
+
+	// The elimination tree of C, and the pattern of L: column j of L has
+	// m_L_colptr[j+1] - m_L_colptr[j] nonzeros, of increasing rows
+	std::vector<int>	m_parent;
+	std::vector<int>	m_L_colptr;
+	std::vector<int>	m_L_indices;
+	std::vector<double>	m_L_values;
+	std::vector<double>	m_D;
+
+	bool				m_factored;
+	int					m_nb_perturbed;
+	int					m_nb_negative;
+};
+
+
+#endif // _SPARSE_LDLT_H_
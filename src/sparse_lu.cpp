@@ -0,0 +1,285 @@
+#include "sparse_lu.h"
+
+#include <cmath>
+#include <algorithm>
+
+
+#define  TAUCS_CORE_DOUBLE
+extern "C" {
+#include <taucs.h>
+}
+
+
+SparseLU::Status SparseLU::factor(const taucs_ccs_matrix* A, const int* colperm, double memory_budget, double pivot_threshold)
+{
+	clear();
+
+	int n = A->n;
+	int nnz = A->colptr[n];
+
+	m_L_colptr.resize(n + 1);
+	m_U_colptr.resize(n + 1);
+	m_pinv.assign(n, -1);
+	m_q.resize(n);
+	m_x.assign(n, 0.0);
+	m_xi.resize(2 * n);
+	m_mark.assign(n, -1);
+
+	// A first guess of the fill
+	std::size_t guess = 2 * static_cast<std::size_t>(nnz) + n;
+	m_L_indices.reserve(guess);
+	m_L_values.reserve(guess);
+	m_U_indices.reserve(guess);
+	m_U_values.reserve(guess);
+
+	m_n = n;
+	for (int k = 0; k < n; ++k) {
+		m_L_colptr[k] = static_cast<int>(m_L_indices.size());
+		m_U_colptr[k] = static_cast<int>(m_U_indices.size());
+
+		int col = (colperm != NULL) ? colperm[k] : k;
+		m_q[k] = col;
+
+		// x = L \ A(:,col)
+		int top = sparse_triangular_solve(A, col, k);
+
+		// The rows already pivoted go to U, the others are pivot candidates
+		int pivot_row = -1;
+		double largest = -1;
+		for (int p = top; p < n; ++p) {
+			int i = m_xi[p];
+			if (m_pinv[i] < 0) {
+				double a = std::fabs(m_x[i]);
+				if (a > largest) {
+					largest = a;
+					pivot_row = i;
+				}
+			}
+			else {
+				m_U_indices.push_back(m_pinv[i]);
+				m_U_values.push_back(m_x[i]);
+			}
+		}
+		if (pivot_row == -1 || largest <= 0) {
+			clear();
+			return SINGULAR;
+		}
+
+		// Prefer the diagonal
+		if (m_pinv[col] < 0 && m_mark[col] == k && std::fabs(m_x[col]) >= pivot_threshold * largest)
+			pivot_row = col;
+
+		double pivot = m_x[pivot_row];
+		m_U_indices.push_back(k);
+		m_U_values.push_back(pivot);
+		m_pinv[pivot_row] = k;
+
+		m_L_indices.push_back(pivot_row);
+		m_L_values.push_back(1.0);
+		for (int p = top; p < n; ++p) {
+			int i = m_xi[p];
+			if (m_pinv[i] < 0) {
+				m_L_indices.push_back(i);
+				m_L_values.push_back(m_x[i] / pivot);
+			}
+			m_x[i] = 0;
+		}
+
+		if ((m_L_indices.size() + m_U_indices.size()) * bytes_per_nonzero() > memory_budget) {
+			clear();
+			return OUT_OF_MEMORY;
+		}
+	}
+	m_L_colptr[n] = static_cast<int>(m_L_indices.size());
+	m_U_colptr[n] = static_cast<int>(m_U_indices.size());
+
+	// The row indices of L in pivot order
+	for (std::size_t p = 0; p < m_L_indices.size(); ++p)
+		m_L_indices[p] = m_pinv[m_L_indices[p]];
+
+	// Release the work arrays
+	std::vector<double>().swap(m_x);
+	std::vector<int>().swap(m_xi);
+	std::vector<int>().swap(m_mark);
+
+	return SUCCESS;
+}
+
+
+void SparseLU::solve(const double* b, double* x) const
+{
+	int n = m_n;
+
+	// y = P*b
+	std::vector<double> y(n);
+	for (int i = 0; i < n; ++i)
+		y[m_pinv[i]] = b[i];
+
+	// y = L \ y
+	for (int j = 0; j < n; ++j) {
+		double yj = y[j];
+		for (int p = m_L_colptr[j] + 1; p < m_L_colptr[j + 1]; ++p)
+			y[m_L_indices[p]] -= m_L_values[p] * yj;
+	}
+
+	// y = U \ y
+	for (int j = n - 1; j >= 0; --j) {
+		int last = m_U_colptr[j + 1] - 1;
+		y[j] /= m_U_values[last];
+		double yj = y[j];
+		for (int p = m_U_colptr[j]; p < last; ++p)
+			y[m_U_indices[p]] -= m_U_values[p] * yj;
+	}
+
+	// x = Q*y
+	for (int k = 0; k < n; ++k)
+		x[m_q[k]] = y[k];
+}
+
+
+void SparseLU::solve(int nrhs, const double* B, int ldb, double* X, int ldx) const
+{
+	int n = m_n;
+
+	// The block of right hand sides, by rows: the values of row i are
+	// contiguous, so that each element of the factor updates a whole row
+	std::vector<double> W(static_cast<std::size_t>(n) * std::min<int>(nrhs, BLOCK_SIZE));
+
+	for (int first = 0; first < nrhs; first += BLOCK_SIZE) {
+		std::size_t nb = std::min<int>(nrhs - first, BLOCK_SIZE);
+
+		// W = P*B
+		for (std::size_t c = 0; c < nb; ++c) {
+			const double* b = B + (first + c) * static_cast<std::size_t>(ldb);
+			for (int i = 0; i < n; ++i)
+				W[m_pinv[i] * nb + c] = b[i];
+		}
+
+		// W = L \ W
+		for (int j = 0; j < n; ++j) {
+			const double* wj = &W[j * nb];
+			for (int p = m_L_colptr[j] + 1; p < m_L_colptr[j + 1]; ++p) {
+				double l = m_L_values[p];
+				double* wi = &W[m_L_indices[p] * nb];
+				for (std::size_t c = 0; c < nb; ++c)
+					wi[c] -= l * wj[c];
+			}
+		}
+
+		// W = U \ W
+		for (int j = n - 1; j >= 0; --j) {
+			int last = m_U_colptr[j + 1] - 1;
+			double* wj = &W[j * nb];
+			double d = m_U_values[last];
+			for (std::size_t c = 0; c < nb; ++c)
+				wj[c] /= d;
+			for (int p = m_U_colptr[j]; p < last; ++p) {
+				double u = m_U_values[p];
+				double* wi = &W[m_U_indices[p] * nb];
+				for (std::size_t c = 0; c < nb; ++c)
+					wi[c] -= u * wj[c];
+			}
+		}
+
+		// X = Q*W
+		for (std::size_t c = 0; c < nb; ++c) {
+			double* x = X + (first + c) * static_cast<std::size_t>(ldx);
+			for (int k = 0; k < n; ++k)
+				x[m_q[k]] = W[k * nb + c];
+		}
+	}
+}
+
+
+void SparseLU::clear()
+{
+	m_n = 0;
+	std::vector<int>().swap(m_L_colptr);
+	std::vector<int>().swap(m_L_indices);
+	std::vector<double>().swap(m_L_values);
+	std::vector<int>().swap(m_U_colptr);
+	std::vector<int>().swap(m_U_indices);
+	std::vector<double>().swap(m_U_values);
+	std::vector<int>().swap(m_pinv);
+	std::vector<int>().swap(m_q);
+	std::vector<double>().swap(m_x);
+	std::vector<int>().swap(m_xi);
+	std::vector<int>().swap(m_mark);
+}
+
+
+std::size_t SparseLU::memory_usage() const
+{
+	return (m_L_colptr.capacity() + m_L_indices.capacity() + m_U_colptr.capacity() + m_U_indices.capacity() +
+		m_pinv.capacity() + m_q.capacity()) * sizeof(int) +
+		(m_L_values.capacity() + m_U_values.capacity()) * sizeof(double);
+}
+
+
+int SparseLU::sparse_triangular_solve(const taucs_ccs_matrix* A, int col, int k)
+{
+	int n = m_n;
+
+	// The nonzeros of x: the rows reachable from those of A(:,col) in the
+	// graph of L
+	int top = n;
+	for (int p = A->colptr[col]; p < A->colptr[col + 1]; ++p) {
+		int i = A->rowind[p];
+		if (m_mark[i] != k)
+			top = depth_first_search(i, k, top);
+	}
+
+	// x = A(:,col)
+	for (int p = A->colptr[col]; p < A->colptr[col + 1]; ++p)
+		m_x[A->rowind[p]] = A->taucs_values[p];
+
+	// x = L \ x, in topological order
+	for (int px = top; px < n; ++px) {
+		int j = m_xi[px];
+		int J = m_pinv[j];
+		if (J < 0)
+			continue;		// not pivoted yet: x[j] is final
+		double xj = m_x[j];
+		for (int p = m_L_colptr[J] + 1; p < m_L_colptr[J + 1]; ++p)
+			m_x[m_L_indices[p]] -= m_L_values[p] * xj;
+	}
+
+	return top;
+}
+
+
+int SparseLU::depth_first_search(int j, int k, int top)
+{
+	int* stack = &m_xi[0];		// grows from 0, while the reach grows down from top
+	int* pstack = &m_xi[m_n];	// the next entry of L to visit for each row of the stack
+
+	int head = 0;
+	stack[0] = j;
+	while (head >= 0) {
+		j = stack[head];
+		int J = m_pinv[j];
+		if (m_mark[j] != k) {
+			m_mark[j] = k;
+			pstack[head] = (J < 0) ? 0 : m_L_colptr[J] + 1;
+		}
+
+		bool done = true;
+		int end = (J < 0) ? 0 : m_L_colptr[J + 1];
+		for (int p = pstack[head]; p < end; ++p) {
+			int i = m_L_indices[p];
+			if (m_mark[i] == k)
+				continue;
+			pstack[head] = p;
+			stack[++head] = i;
+			done = false;
+			break;
+		}
+
+		if (done) {
+			--head;
+			m_xi[--top] = j;
+		}
+	}
+
+	return top;
+}
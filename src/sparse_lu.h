@@ -0,0 +1,104 @@
+#ifndef _SPARSE_LU_H_
+#define _SPARSE_LU_H_
+
+// The class SparseLU is an in-core sparse LU factorization with partial
+// pivoting of a square (non-symmetric) TAUCS matrix, which TAUCS only offers
+// out-of-core. The factorization is left-looking (Gilbert-Peierls): column k
+// of L and U is computed by a sparse triangular solve with the first k
+// columns of L, so that the work is proportional to the number of floating
+// point operations.
+//
+// A given column ordering Q (e.g., colamd) reduces the fill. The rows are
+// permuted by the pivoting: P*A*Q = L*U, with L unit lower triangular.
+// The pivot of a column is the diagonal element if its magnitude is at least
+// pivot_threshold times the largest candidate (which preserves the sparsity
+// of the column ordering), otherwise the largest candidate.
+
+#include <vector>
+#include <cstddef>
+
+
+struct taucs_ccs_matrix;
+
+class SparseLU
+{
+public:
+	enum Status {
+		SUCCESS,
+		SINGULAR,		// no nonzero pivot for some column
+		OUT_OF_MEMORY	// the factor would use more than the memory budget
+	};
+
+public:
+	SparseLU() : m_n(0) {}
+
+	/// Factor the square matrix A, not symmetric (both triangles are stored).
+	/// colperm: the column ordering (NULL for the identity).
+	/// memory_budget: the maximum number of bytes for the factor. The
+	///                factorization stops as soon as the factor outgrows it.
+	/// pivot_threshold: in (0, 1], 1 for the usual partial pivoting.
+	/// The previous factor is released first.
+	Status factor(const taucs_ccs_matrix* A, const int* colperm, double memory_budget, double pivot_threshold = 0.1);
+
+	/// solve for "A*x=b" with the factor. x and b can be the same array.
+	void solve(const double* b, double* x) const;
+
+	/// solve for "A*X=B" with the factor, for nrhs right hand sides stored by
+	/// columns: column c of B (X) starts at B + c*ldb (X + c*ldx). The factor
+	/// is traversed once for each block of BLOCK_SIZE right hand sides.
+	/// X and B can be the same array.
+	void solve(int nrhs, const double* B, int ldb, double* X, int ldx) const;
+
+	enum { BLOCK_SIZE = 32 };
+
+	/// Return true if a factor is available for solve()
+	bool is_factored() const { return m_n > 0; }
+
+	/// Release the factor
+	void clear();
+
+	/// Return the number of nonzeros of L and U
+	std::size_t nnz() const { return m_L_indices.size() + m_U_indices.size(); }
+
+	/// Return the number of bytes used to store the factor
+	std::size_t memory_usage() const;
+
+	/// The number of bytes needed to store nnz nonzeros of L or U
+	static double bytes_per_nonzero() { return sizeof(int) + sizeof(double); }
+
+private:
+	// Compute x = L \ A(:,col) with the first k columns of L, where x is
+	// scattered in m_x. Return top, such that m_xi[top .. n-1] are the
+	// (original) row indices of the nonzeros of x.
+	int sparse_triangular_solve(const taucs_ccs_matrix* A, int col, int k);
+
+	// Depth-first search in the graph of L from row j, pushing the rows
+	// reached onto m_xi[.. top-1] in topological order. Return the new top.
+	int depth_first_search(int j, int k, int top);
+
+private:
+	int					m_n;
+
+	// L (unit diagonal stored first in each column) and U (diagonal stored
+	// last in each column), in compressed columns. The row indices of L are
+	// the original rows of A during the factorization, and pivot steps after.
+	std::vector<int>	m_L_colptr;
+	std::vector<int>	m_L_indices;
+	std::vector<double>	m_L_values;
+	std::vector<int>	m_U_colptr;
+	std::vector<int>	m_U_indices;
+	std::vector<double>	m_U_values;
+
+	// m_pinv[i] is the pivot step of row i of A (P), m_q[k] the column of A
+	// at step k (Q)
+	std::vector<int>	m_pinv;
+	std::vector<int>	m_q;
+
+	// Work arrays of the factorization
+	std::vector<double>	m_x;
+	std::vector<int>	m_xi;		// the reach of a column (n) and the stack of the search (n)
+	std::vector<int>	m_mark;		// m_mark[i] == k if row i was reached at step k
+};
+
+
+#endif // _SPARSE_LU_H_
@@ -1,5 +1,13 @@
 #include "sparse_matrix.h"
+#include <algorithm>
 #include <cassert>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <new>
+#include <stdexcept>
 
 
 
@@ -12,6 +20,12 @@ SparseMatrix::SparseMatrix(int dim, bool is_symmetric /* = false*/)
 	m_column_dimension  = dim;
 	m_columns           = new Column[m_column_dimension];
 	m_is_symmetric      = is_symmetric;
+	m_pattern_version   = 0;
+	m_values_version    = 0;
+	m_frozen_colptr     = NULL;
+	m_frozen_rowind     = NULL;
+	m_frozen_values     = NULL;
+	m_lazy_columns      = false;
 }
 
 /// Create a rectangular matrix initialized with zeros.
@@ -27,6 +41,12 @@ SparseMatrix::SparseMatrix(int rows, int columns, bool is_symmetric /* = false*/
 	m_column_dimension  = columns;
 	m_columns           = new Column[m_column_dimension];
 	m_is_symmetric      = is_symmetric;
+	m_pattern_version   = 0;
+	m_values_version    = 0;
+	m_frozen_colptr     = NULL;
+	m_frozen_rowind     = NULL;
+	m_frozen_values     = NULL;
+	m_lazy_columns      = false;
 }
 
 SparseMatrix::~SparseMatrix()
@@ -49,41 +69,232 @@ double  SparseMatrix::get_coef(int i, int j) const
 
 	assert(i < m_row_dimension);
 	assert(j < m_column_dimension);
-	return m_columns[j].get_coef(i);
+	if (has_compressed_arrays()) {
+		int slot = get_slot(i, j);
+		return (slot >= 0) ? m_frozen_values[slot] : 0;
+	}
+	return m_columns[j].get_coef(m_pool, i);
 }
 
 /// Write access to a matrix coefficient: a_ij <- val.
 /// Optimization:
 /// For symmetric matrices, SparseMatrix stores only the lower triangle
 /// set_coef() does nothing if (i, j) belongs to the upper triangle.
+/// Return false if the pattern is frozen and a_ij does not belong to it.
 /// Preconditions:
 /// - 0 <= i < row_dimension().
 /// - 0 <= j < column_dimension().
-void SparseMatrix::set_coef(int i, int j, double val)
+bool SparseMatrix::set_coef(int i, int j, double val)
 {
 	if (m_is_symmetric && (j > i))
-		return;
+		return true;
 
 	assert(i < m_row_dimension);
 	assert(j < m_column_dimension);
-	m_columns[j].set_coef(i, val);
+	if (has_compressed_arrays()) {
+		int slot = get_slot(i, j);
+		if (slot >= 0) {
+			set_coef_at(slot, val);
+			return true;
+		}
+		if (!m_lazy_columns) {
+			std::cout << title() << "a_" << i << "," << j << " does not belong to the frozen pattern" << std::endl;
+			return false;
+		}
+		// Move the elements to the columns, which can receive new elements
+		unfreeze_pattern();
+	}
+	record_change(m_columns[j].set_coef(m_pool, i, val));
+	compact_if_needed();
+	return true;
 }
 
 /// Write access to a matrix coefficient: a_ij <- a_ij + val.
 /// Optimization:
 /// For symmetric matrices, SparseMatrix stores only the lower triangle
 /// add_coef() does nothing if (i, j) belongs to the upper triangle.
+/// Return false if the pattern is frozen and a_ij does not belong to it.
 /// Preconditions:
 /// - 0 <= i < row_dimension().
 /// - 0 <= j < column_dimension().
-void SparseMatrix::add_coef(int i, int j, double val)
+bool SparseMatrix::add_coef(int i, int j, double val)
 {
 	if (m_is_symmetric && (j > i))
-		return;
+		return true;
 
 	assert(i < m_row_dimension);
 	assert(j < m_column_dimension);
-	m_columns[j].add_coef(i, val);
+	if (has_compressed_arrays()) {
+		int slot = get_slot(i, j);
+		if (slot >= 0) {
+			add_coef_at(slot, val);
+			return true;
+		}
+		if (!m_lazy_columns) {
+			std::cout << title() << "a_" << i << "," << j << " does not belong to the frozen pattern" << std::endl;
+			return false;
+		}
+		// Move the elements to the columns, which can receive new elements
+		unfreeze_pattern();
+	}
+	record_change(m_columns[j].add_coef(m_pool, i, val));
+	compact_if_needed();
+	return true;
+}
+
+/// Set all the stored coefficients to zero, keeping the sparsity pattern.
+void SparseMatrix::set_zero()
+{
+	if (has_compressed_arrays()) {
+		std::fill(m_frozen_values, m_frozen_values + m_frozen_colptr[m_column_dimension], 0.0);
+	}
+	else {
+		for (int col=0; col < m_column_dimension; col++)
+			std::fill(m_pool.values(m_columns[col]), m_pool.values(m_columns[col]) + m_columns[col].dimension(), 0.0);
+	}
+	++m_values_version;
+}
+
+/// Return the number of bytes used to store the matrix
+std::size_t SparseMatrix::memory_usage() const
+{
+	return sizeof(SparseMatrix) + m_column_dimension * sizeof(Column) + m_pool.memory_usage();
+}
+
+/// Return the slot of a_ij in the values array, or -1 if a_ij does not
+/// belong to the pattern.
+int SparseMatrix::get_slot(int i, int j) const
+{
+	assert(has_compressed_arrays());
+
+	if (m_is_symmetric && (j > i))
+		std::swap(i, j);
+
+	// The rows of each column are sorted
+	const int* begin = m_frozen_rowind + m_frozen_colptr[j];
+	const int* end   = m_frozen_rowind + m_frozen_colptr[j+1];
+	const int* it    = std::lower_bound(begin, end, i);
+	if (it == end || *it != i)
+		return -1;
+	return static_cast<int>(it - m_frozen_rowind);
+}
+
+/// Replace all the stored coefficients at once.
+bool SparseMatrix::update_values(const double* values)
+{
+	if (!has_compressed_arrays()) {
+		std::cout << title() << "the pattern is not frozen" << std::endl;
+		return false;
+	}
+	std::copy(values, values + m_frozen_colptr[m_column_dimension], m_frozen_values);
+	++m_values_version;
+	return true;
+}
+
+/// Freeze the sparsity pattern: the elements are moved to the given compressed
+/// column arrays and the columns are released.
+void SparseMatrix::freeze_pattern(int* colptr, int* rowind, double* values)
+{
+	assert(!has_compressed_arrays());
+
+	colptr[0] = 0;
+	for (int col=0; col < m_column_dimension; col++) {
+		const Column& column = m_columns[col];
+		std::copy(m_pool.indices(column), m_pool.indices(column) + column.dimension(), rowind + colptr[col]);
+		std::copy(m_pool.values(column), m_pool.values(column) + column.dimension(), values + colptr[col]);
+		colptr[col+1] = colptr[col] + column.dimension();
+	}
+
+	// release the memory
+	m_pool.clear(m_columns, m_column_dimension, true);
+
+	m_frozen_colptr = colptr;
+	m_frozen_rowind = rowind;
+	m_frozen_values = values;
+}
+
+/// Move the elements back from the compressed column arrays to the columns.
+void SparseMatrix::unfreeze_pattern()
+{
+	assert(has_compressed_arrays());
+
+	int nnz = m_frozen_colptr[m_column_dimension];
+	int*    indices = ColumnPool::allocate<int>(nnz);
+	double* values  = ColumnPool::allocate<double>(nnz);
+	memcpy(indices, m_frozen_rowind, nnz * sizeof(int));
+	memcpy(values, m_frozen_values, nnz * sizeof(double));
+	m_pool.adopt(m_columns, m_column_dimension, m_frozen_colptr, indices, values);
+
+	m_frozen_colptr = NULL;
+	m_frozen_rowind = NULL;
+	m_frozen_values = NULL;
+	m_lazy_columns  = false;
+}
+
+/// Freeze the sparsity pattern on compressed column arrays that already hold
+/// the elements, without any copy.
+void SparseMatrix::attach_pattern(int* colptr, int* rowind, double* values)
+{
+	assert(!has_compressed_arrays());
+
+#ifndef NDEBUG
+	for (int col=0; col < m_column_dimension; col++) {
+		assert(m_columns[col].dimension() == 0);
+		for (int k = colptr[col]; k < colptr[col+1]; k++) {
+			assert(rowind[k] >= 0 && rowind[k] < m_row_dimension);
+			assert(k == colptr[col] || rowind[k-1] < rowind[k]);
+			assert(!m_is_symmetric || rowind[k] >= col);
+		}
+	}
+#endif
+
+	m_pool.clear(m_columns, m_column_dimension, true);
+
+	m_frozen_colptr = colptr;
+	m_frozen_rowind = rowind;
+	m_frozen_values = values;
+	++m_pattern_version;
+}
+
+/// Store the elements in compressed column arrays that already hold them,
+/// without freezing the pattern.
+void SparseMatrix::attach_elements(int* colptr, int* rowind, double* values)
+{
+	attach_pattern(colptr, rowind, values);
+	m_lazy_columns = true;
+}
+
+/// Remove all the elements and release their memory.
+void SparseMatrix::release_elements()
+{
+	m_pool.clear(m_columns, m_column_dimension, true);
+
+	m_frozen_colptr = NULL;
+	m_frozen_rowind = NULL;
+	m_frozen_values = NULL;
+	m_lazy_columns  = false;
+	++m_pattern_version;
+}
+
+void SparseMatrix::record_change(Column::Change change)
+{
+	if (change == Column::INSERTED)
+		++m_pattern_version;
+	else if (change == Column::VALUE_CHANGED)
+		++m_values_version;
+}
+
+void SparseMatrix::compact_if_needed()
+{
+	if (m_pool.needs_compaction())
+		m_pool.compact(m_columns, m_column_dimension, false);
+}
+
+/// Store the elements exactly like a compressed column storage: the columns
+/// are contiguous, in column order and without free space.
+void SparseMatrix::compact() const
+{
+	m_pool.compact(m_columns, m_column_dimension, true);
 }
 
 
@@ -93,61 +304,218 @@ void SparseMatrix::add_coef(int i, int j, double val)
 
 
 // column{index} <- column{index} + val
-void Column::add_coef(int index, double val)
-{
-	// Search for element in vectors
-	std::vector<int>::iterator		index_it;
-	std::vector<double>::iterator   value_it;
-	for (index_it = m_indices.begin(), value_it = m_values.begin();
-		index_it != m_indices.end();
-		++index_it, ++value_it)
-	{
-		if(*index_it == index) {
-			*value_it += val;       // +=
-			return;
-		}
+Column::Change Column::add_coef(ColumnPool& pool, int index, double val)
+{
+	int pos = lower_bound(pool, index);
+	if (pos < dimension() && pool.indices(*this)[pos] == index) {
+		if (val == 0)
+			return UNCHANGED;
+		pool.values(*this)[pos] += val;		// +=
+		return VALUE_CHANGED;
 	}
 
 	// Element doesn't exist yet if we reach this point
-	m_indices.push_back(index);
-	m_values.push_back(val);
+	insert(pool, pos, index, val);
+	return INSERTED;
 }
 
 // column{index} <- val
-void Column::set_coef(int index, double val)
-{
-	// Search for element in vectors
-	std::vector<int>::iterator		index_it;
-	std::vector<double>::iterator   value_it;
-	for (index_it = m_indices.begin(), value_it = m_values.begin();
-		index_it != m_indices.end();
-		++index_it, ++value_it)
-	{
-		if(*index_it == index) {
-			*value_it = val;        // =
-			return;
-		}
+Column::Change Column::set_coef(ColumnPool& pool, int index, double val)
+{
+	int pos = lower_bound(pool, index);
+	if (pos < dimension() && pool.indices(*this)[pos] == index) {
+		double& value = pool.values(*this)[pos];
+		if (value == val)
+			return UNCHANGED;
+		value = val;						// =
+		return VALUE_CHANGED;
 	}
 
 	// Element doesn't exist yet if we reach this point
-	m_indices.push_back(index);
-	m_values.push_back(val);
+	insert(pool, pos, index, val);
+	return INSERTED;
 }
 
 // return column{index} (0 by default)
-double Column::get_coef(int index) const
+double Column::get_coef(const ColumnPool& pool, int index) const
 {
-	// Search for element in vectors
-	std::vector<int>::const_iterator	index_it;
-	std::vector<double>::const_iterator value_it;
-	for (index_it = m_indices.begin(), value_it = m_values.begin();
-		index_it != m_indices.end();
-		++index_it, ++value_it)
-	{
-		if(*index_it == index)
-			return *value_it;       // return value
-	}
+	int pos = lower_bound(pool, index);
+	if (pos < dimension() && pool.indices(*this)[pos] == index)
+		return pool.values(*this)[pos];		// return value
 
 	// Element doesn't exist yet if we reach this point
 	return 0;
 }
+
+int Column::lower_bound(const ColumnPool& pool, int index) const
+{
+	const int* indices = pool.indices(*this);
+
+	// Fast path: appending at the end of the column
+	if (m_size == 0 || indices[m_size - 1] < index)
+		return m_size;
+
+	// Binary search in the sorted indices
+	return static_cast<int>(std::lower_bound(indices, indices + m_size, index) - indices);
+}
+
+void Column::insert(ColumnPool& pool, int pos, int index, double val)
+{
+	if (m_size == m_capacity)
+		pool.reserve(*this, std::max(4, 2 * m_capacity));
+
+	int*    indices = pool.indices(*this);
+	double* values  = pool.values(*this);
+	std::copy_backward(indices + pos, indices + m_size, indices + m_size + 1);
+	std::copy_backward(values + pos, values + m_size, values + m_size + 1);
+	indices[pos] = index;
+	values[pos]  = val;
+	++m_size;
+}
+
+
+
+//////////////////////////////////////////////////////////////////////////
+
+
+
+ColumnPool::~ColumnPool()
+{
+	free(m_indices);
+	free(m_values);
+}
+
+// Make room for at least capacity elements in the column
+void ColumnPool::reserve(Column& column, int capacity)
+{
+	if (capacity <= column.m_capacity)
+		return;
+
+	// The column is the last one of the pool: extend it in place
+	if (column.m_begin + column.m_capacity == m_end && column.m_capacity > 0) {
+		grow(static_cast<long long>(column.m_begin) + capacity);
+		m_end = column.m_begin + capacity;
+	}
+	else {
+		SparseOffset begin = m_end;
+		grow(static_cast<long long>(m_end) + capacity);
+		m_end += capacity;
+		memcpy(m_indices + begin, m_indices + column.m_begin, column.m_size * sizeof(int));
+		memcpy(m_values + begin, m_values + column.m_begin, column.m_size * sizeof(double));
+
+		m_wasted += column.m_capacity;
+		column.m_begin = begin;
+	}
+
+	column.m_capacity = capacity;
+}
+
+// Replace the content of the column by size (indices, values)
+void ColumnPool::assign(Column& column, const int* indices, const double* values, int size)
+{
+	column.m_size = 0;
+	reserve(column, size);
+	std::copy(indices, indices + size, this->indices(column));
+	std::copy(values, values + size, this->values(column));
+	column.m_size = size;
+}
+
+// Store the columns contiguously, in column order.
+void ColumnPool::compact(Column* columns, int nb_columns, bool shrink)
+{
+	SparseOffset size = 0;
+	for (int col = 0; col < nb_columns; ++col)
+		size += shrink ? columns[col].m_size : columns[col].m_capacity;
+
+	// Already compact: the columns are contiguous, in column order (reserve()
+	// moves a column to the end of the pool, so a pool without gaps can still
+	// hold the columns out of order)
+	if (shrink && size == m_end && size == m_capacity) {
+		SparseOffset begin = 0;
+		int col = 0;
+		while (col < nb_columns && columns[col].m_begin == begin && columns[col].m_capacity == columns[col].m_size)
+			begin += columns[col++].m_size;
+		if (col == nb_columns)
+			return;
+	}
+
+	int*	indices = allocate<int>(size);
+	double*	values  = allocate<double>(size);
+	SparseOffset begin = 0;
+	for (int col = 0; col < nb_columns; ++col) {
+		Column& column = columns[col];
+		memcpy(indices + begin, m_indices + column.m_begin, column.m_size * sizeof(int));
+		memcpy(values + begin, m_values + column.m_begin, column.m_size * sizeof(double));
+		if (shrink)
+			column.m_capacity = column.m_size;
+		column.m_begin = begin;
+		begin += column.m_capacity;
+	}
+
+	free(m_indices);
+	free(m_values);
+	m_indices  = indices;
+	m_values   = values;
+	m_capacity = size;
+	m_end      = size;
+	m_wasted   = 0;
+}
+
+// Replace the arrays by indices and values, holding size elements
+void ColumnPool::take(int* indices, double* values, SparseOffset size)
+{
+	free(m_indices);
+	free(m_values);
+	m_indices  = indices;
+	m_values   = values;
+	m_capacity = size;
+	m_end      = size;
+	m_wasted   = 0;
+}
+
+// Remove all the columns
+void ColumnPool::clear(Column* columns, int nb_columns, bool release_memory)
+{
+	for (int col = 0; col < nb_columns; ++col)
+		columns[col] = Column();
+
+	if (release_memory) {
+		free(m_indices);
+		free(m_values);
+		m_indices  = NULL;
+		m_values   = NULL;
+		m_capacity = 0;
+	}
+	m_end = 0;
+	m_wasted = 0;
+}
+
+// Return the number of bytes allocated by the pool
+std::size_t ColumnPool::memory_usage() const
+{
+	return static_cast<std::size_t>(m_capacity) * (sizeof(int) + sizeof(double));
+}
+
+// Make room for size elements in the arrays.
+// Implementation note: the arrays grow with realloc(), which can
+// remap the pages of large arrays instead of copying them.
+void ColumnPool::grow(long long size)
+{
+	if (size <= m_capacity)
+		return;
+
+	const long long max_size = std::numeric_limits<SparseOffset>::max();
+	if (size > max_size)
+		throw std::length_error("too many elements in a SparseMatrix (see TAUCS_SOLVER_64BIT_OFFSETS)");
+
+	SparseOffset capacity = static_cast<SparseOffset>(std::min(max_size, std::max(size, m_capacity + m_capacity / 2LL)));
+	int*    indices = static_cast<int*>(realloc(m_indices, capacity * sizeof(int)));
+	if (indices == NULL)
+		throw std::bad_alloc();
+	m_indices = indices;
+	double* values  = static_cast<double*>(realloc(m_values, capacity * sizeof(double)));
+	if (values == NULL)
+		throw std::bad_alloc();
+	m_values = values;
+	m_capacity = capacity;
+}
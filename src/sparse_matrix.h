@@ -7,45 +7,174 @@
 // This codes is copied and modified a little from CGAL/Taucs_matrix.h
 
 #include <vector>
+#include <string>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
 
 
 
+// The type of the positions and counts of elements in the storage of a matrix.
+// It limits the number of nonzeros of a matrix to 2^31-1 by default. Define
+// TAUCS_SOLVER_64BIT_OFFSETS to assemble larger matrices (each column keeps 
+// 32-bit row indices, so that only one 64-bit offset per column is added).
+// Note: TAUCS itself uses int, so a matrix exported to TAUCS must still have
+// less than 2^31 nonzeros (see TaucsMatrix::get_taucs_matrix()).
+#ifdef TAUCS_SOLVER_64BIT_OFFSETS
+typedef long long	SparseOffset;
+#else
+typedef int			SparseOffset;
+#endif
+
+
+class ColumnPool;
+
 /*
 * A column of a SparseMatrix. The column is compressed, and stored in the form of
-* (a vector of values) + (a vector of indices).
+* (a range of values) + (a range of indices) in the ColumnPool of the matrix.
+* The indices are kept sorted in increasing order, so that looking up an element
+* costs O(log(dimension())) instead of a linear scan. Elements arriving in
+* increasing row order (the common case) are simply appended.
 * NOTE: client code should use this class
 */
 class Column
 {
 public:
+	// What add_coef() and set_coef() did to the column
+	enum Change { UNCHANGED, VALUE_CHANGED, INSERTED };
+
+	Column() : m_begin(0), m_size(0), m_capacity(0) {}
+
 	// Return the number of elements in the column
-	int dimension() const    { return static_cast<int>(m_values.size()); }
+	int dimension() const    { return m_size; }
 
 	// column{index} <- column{index} + val
-	void add_coef(int index, double val);
+	Change add_coef(ColumnPool& pool, int index, double val);
 
 	// column{index} <- val
-	void   set_coef(int index, double val);
-	double get_coef(int index) const;
+	Change set_coef(ColumnPool& pool, int index, double val);
+	double get_coef(const ColumnPool& pool, int index) const;
+
+private:
+	// Return the position of index in the column, or the position where 
+	// it should be inserted to keep the indices sorted.
+	int lower_bound(const ColumnPool& pool, int index) const;
+
+	// Insert a new element at position pos (returned by lower_bound())
+	void insert(ColumnPool& pool, int pos, int index, double val);
 
 public:
-	// (Vector of values) + (vector of indices) (linked)
-	std::vector<double>	m_values;
-	std::vector<int>	m_indices;
+	// The column occupies [m_begin, m_begin + m_size) in the pool, and
+	// there is room for m_capacity elements.
+	SparseOffset	m_begin;
+	int		m_size;
+	int		m_capacity;
 }; // class Column
 
 
 
+/*
+* The storage of the columns of a SparseMatrix: one contiguous array of indices
+* and one contiguous array of values, shared by all the columns. This avoids two
+* heap allocations (and their growth slack) per column.
+* A column that needs more room than it has is moved to the end of the pool
+* (with twice the capacity). The space it leaves is wasted until compact() is 
+* called, which SparseMatrix does when more than half of the pool is wasted,
+* and before exporting the matrix (see TaucsMatrix::get_taucs_matrix()).
+*/
+class ColumnPool
+{
+public:
+	ColumnPool() : m_indices(NULL), m_values(NULL), m_capacity(0), m_end(0), m_wasted(0) {}
+	~ColumnPool();
+
+	// Access to the indices and values of a column
+	const int*    indices(const Column& column) const { return m_indices + column.m_begin; }
+	int*          indices(const Column& column)       { return m_indices + column.m_begin; }
+	const double* values(const Column& column) const  { return m_values + column.m_begin; }
+	double*       values(const Column& column)        { return m_values + column.m_begin; }
+
+	// Make room for at least capacity elements in the column
+	void reserve(Column& column, int capacity);
+
+	// Replace the content of the column by size (indices, values)
+	void assign(Column& column, const int* indices, const double* values, int size);
+
+	// Is more than half of the pool wasted by moved columns?
+	bool needs_compaction() const { return m_wasted > m_end / 2; }
+
+	// Store the columns contiguously, in column order. If shrink is true, the
+	// free space of the columns is removed too: the pool is then exactly the 
+	// compressed column storage of the columns. Otherwise, the columns keep 
+	// their capacity, so that they do not all have to move again.
+	void compact(Column* columns, int nb_columns, bool shrink);
+
+	// Take the ownership of indices and values (allocated with allocate()),
+	// i.e., the compressed column storage of the columns, whose column j 
+	// starts at colptr[j] (colptr is an array of int or SparseOffset).
+	template <class Offset>
+	void adopt(Column* columns, int nb_columns, const Offset* colptr, int* indices, double* values) {
+		take(indices, values, colptr[nb_columns]);
+		for (int col = 0; col < nb_columns; ++col) {
+			columns[col].m_begin    = colptr[col];
+			columns[col].m_size     = static_cast<int>(colptr[col + 1] - colptr[col]);
+			columns[col].m_capacity = columns[col].m_size;
+		}
+	}
+
+	// Allocate an array that adopt() can take (throw std::bad_alloc on failure)
+	template <class T>
+	static T* allocate(SparseOffset size) {
+		T* array = static_cast<T*>(malloc((size > 0 ? static_cast<std::size_t>(size) : 1) * sizeof(T)));
+		if (array == NULL)
+			throw std::bad_alloc();
+		return array;
+	}
+
+	// Remove all the columns. The memory is released if release_memory is true.
+	void clear(Column* columns, int nb_columns, bool release_memory);
+
+	// Return the number of bytes allocated by the pool
+	std::size_t memory_usage() const;
+
+private:
+	// Make room for size elements in the arrays (throw std::length_error if
+	// size cannot be represented by SparseOffset)
+	void grow(long long size);
+
+	// Replace the arrays by indices and values, holding size elements
+	void take(int* indices, double* values, SparseOffset size);
+
+	// ColumnPool cannot be copied
+	ColumnPool(const ColumnPool& rhs);
+	ColumnPool& operator=(const ColumnPool& rhs);
+
+private:
+	int*				m_indices;
+	double*				m_values;
+	// Number of allocated elements
+	SparseOffset		m_capacity;
+
+	// End of the used part of the arrays
+	SparseOffset		m_end;
+	// Number of elements wasted by moved columns
+	SparseOffset		m_wasted;
+}; // class ColumnPool
+
+
+
 
 
 class SparseMatrix
 {
 public:
+	static std::string title() { return "[SparseMatrix]: "; }
+
 	/// Create a square matrix initialized with zeros.
 	SparseMatrix(int dim, bool is_symmetric = false);
 	/// Create a rectangular matrix initialized with zeros.
 	SparseMatrix(int rows, int columns, bool is_symmetric = false);
-	~SparseMatrix();
+	virtual ~SparseMatrix();
 
 	/// Return the matrix number of rows
 	int row_dimension() const    { return m_row_dimension; }
@@ -62,25 +191,104 @@ public:
 	/// Optimization:
 	/// For symmetric matrices, SparseMatrix stores only the lower triangle
 	/// set_coef() does nothing if (i, j) belongs to the upper triangle.
+	/// Return false (and leave the matrix unchanged) if the pattern is frozen
+	/// and a_ij does not belong to it.
 	/// Preconditions:
 	/// - 0 <= i < row_dimension().
 	/// - 0 <= j < column_dimension().
-	void set_coef(int i, int j, double val);
+	bool set_coef(int i, int j, double val);
 
 	/// Write access to a matrix coefficient: a_ij <- a_ij + val.
 	/// Optimization:
 	/// For symmetric matrices, SparseMatrix stores only the lower triangle
 	/// add_coef() does nothing if (i, j) belongs to the upper triangle.
+	/// Return false (and leave the matrix unchanged) if the pattern is frozen
+	/// and a_ij does not belong to it.
+	/// Preconditions:
+	/// - 0 <= i < row_dimension().
+	/// - 0 <= j < column_dimension().
+	bool add_coef(int i, int j, double val);
+
+	/// Set all the stored coefficients to zero, keeping the sparsity pattern.
+	void set_zero();
+
+	/// Return the number of bytes used to store the matrix (including what
+	/// derived classes store, e.g., the TAUCS matrix of TaucsMatrix)
+	virtual std::size_t memory_usage() const;
+
+	/// Release the free space left by the assembly: the elements are then stored
+	/// exactly like a compressed column storage (contiguous, in column order).
+	/// This does not change the matrix. get_taucs_matrix() calls it.
+	void compact() const;
+
+	//////////////////////////////////////////////////////////////////////////
+	// Frozen sparsity pattern (see TaucsMatrix::freeze_pattern()).
+	// The elements are then stored in compressed column arrays, and the
+	// coefficients can also be accessed through their position ("slot") 
+	// in the values array. Inserting a new element is not allowed.
+
+	/// Is the sparsity pattern frozen?
+	bool is_pattern_frozen() const { return m_frozen_colptr != NULL && !m_lazy_columns; }
+
+	/// Return the slot of a_ij in the values array, or -1 if a_ij does not
+	/// belong to the pattern. For symmetric matrices, (i, j) and (j, i) share
+	/// the slot of the lower triangle element.
 	/// Preconditions:
+	/// - has_compressed_arrays().
 	/// - 0 <= i < row_dimension().
 	/// - 0 <= j < column_dimension().
-	void add_coef(int i, int j, double val);
+	int get_slot(int i, int j) const;
+
+	/// Write access to the coefficient stored at a slot returned by get_slot().
+	void set_coef_at(int slot, double val) { m_frozen_values[slot]  = val; ++m_values_version; }
+	void add_coef_at(int slot, double val) { m_frozen_values[slot] += val; ++m_values_version; }
+
+	/// Replace all the stored coefficients at once: values[slot] is the new
+	/// value of the element at that slot.
+	/// Return false (and leave the matrix unchanged) if the pattern is not frozen.
+	bool update_values(const double* values);
+
+protected:
+	/// Freeze the sparsity pattern: the elements are moved to the given compressed
+	/// column arrays (owned by the caller, sized for the current pattern, rows 
+	/// sorted in each column) and the columns are released.
+	void freeze_pattern(int* colptr, int* rowind, double* values);
+
+	/// Move the elements back from the compressed column arrays to the columns.
+	void unfreeze_pattern();
+
+	/// Freeze the sparsity pattern on compressed column arrays that already hold
+	/// the elements (owned by the caller, rows sorted in each column), without 
+	/// any copy. The columns must be empty.
+	void attach_pattern(int* colptr, int* rowind, double* values);
+
+	/// Store the elements in compressed column arrays that already hold them,
+	/// like attach_pattern(), but without freezing the pattern: the elements
+	/// are copied into the columns (see unfreeze_pattern()) only when an 
+	/// element outside the pattern is inserted.
+	void attach_elements(int* colptr, int* rowind, double* values);
+
+	/// Are the elements stored in compressed column arrays (frozen pattern or
+	/// attach_elements())?
+	bool has_compressed_arrays() const { return m_frozen_colptr != NULL; }
+
+	/// Remove all the elements and release their memory (the pattern is then 
+	/// not frozen anymore, and the compressed column arrays are left untouched).
+	void release_elements();
 
 private:
+	friend class ParallelAssembler;
+
 	/// SparseMatrix cannot be copied (yet)
 	SparseMatrix(const SparseMatrix& rhs);
 	SparseMatrix& operator=(const SparseMatrix& rhs);
 
+	/// Update the modification counters after a change of a column
+	void record_change(Column::Change change);
+
+	/// Compact the pool if it wastes too much memory
+	void compact_if_needed();
+
 protected:
 	// Matrix dimensions
 	int     m_row_dimension;
@@ -89,9 +297,27 @@ protected:
 	// Columns array
 	Column* m_columns;
 
+	// Storage of the elements of the columns (mutable for compact())
+	mutable ColumnPool m_pool;
+
 	// Symmetric/hermitian?
 	bool    m_is_symmetric;
 
+	// Modification counters, which allow derived classes to keep copies in sync.
+	// m_pattern_version is incremented when new elements are inserted, and 
+	// m_values_version when the values of existing elements change.
+	unsigned long long m_pattern_version;
+	unsigned long long m_values_version;
+
+	// Compressed column arrays of a frozen pattern (NULL if not frozen)
+	int*	m_frozen_colptr;
+	int*	m_frozen_rowind;
+	double* m_frozen_values;
+
+	// True if the compressed column arrays hold the elements but the pattern
+	// is not frozen (see attach_elements())
+	bool	m_lazy_columns;
+
 }; // SparseMatrix
 
 
@@ -0,0 +1,1406 @@
+#include "taucs_factorization.h"
+#include "taucs_matrix.h"
+#include "taucs_util.h"
+#include "parallel.h"
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <cmath>
+#include <atomic>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+
+#define  TAUCS_CORE_DOUBLE
+extern "C" {
+#include <taucs.h>
+}
+
+
+TaucsFactorization::TaucsFactorization()
+	: m_matrix(NULL)
+	, m_mode(SYMMETRIC)
+	, m_rows(0)
+	, m_columns(0)
+	, m_ordering(DEFAULT_ORDERING)
+	, m_ordering_changed(false)
+	, m_selected_ordering(DEFAULT_ORDERING)
+	, m_analyzed(false)
+	, m_factor(NULL)
+	, m_ooc_llt(NULL)
+	, m_predicted_factor_size(0)
+	, m_factor_ccs(NULL)
+	, m_fingerprint(0)
+	, m_pivot_tolerance(1e-8)
+	, m_backward_error(0)
+	, m_lu(NULL)
+	, m_memory_budget(-1)
+	, m_force_out_of_core(false)
+	, m_num_threads(Parallel::default_num_threads())
+	, m_factorization_cost(0)
+	, m_update_stamp(0)
+	, m_updated(false)
+	, m_updated_matrix(NULL)
+	, m_factored(false)
+{
+}
+
+
+TaucsFactorization::~TaucsFactorization()
+{
+	release();
+}
+
+
+bool TaucsFactorization::analyze(const TaucsMatrix& matrix, Mode mode)
+{
+	release();
+
+	if (!check_dimensions(matrix, mode))
+		return false;
+
+	m_mode = mode;
+	const taucs_ccs_matrix* M = matrix_to_factor(matrix);
+	if (M == NULL)
+		return false;
+
+	if (!analyze_matrix(M))
+		return false;
+
+	m_matrix = &matrix;
+	m_rows = matrix.row_dimension();
+	m_columns = matrix.column_dimension();
+	return true;
+}
+
+
+bool TaucsFactorization::factor(const TaucsMatrix& matrix, Mode mode)
+{
+	if (!check_dimensions(matrix, mode)) {
+		release();
+		return false;
+	}
+
+	// The analysis cannot be reused for another mode
+	if (m_analyzed && mode != m_mode)
+		release();
+
+	free_numeric();
+	clear_updates();
+	m_mode = mode;
+	m_matrix = &matrix;
+	m_rows = matrix.row_dimension();
+	m_columns = matrix.column_dimension();
+
+	const taucs_ccs_matrix* M = matrix_to_factor(matrix);
+	if (M == NULL)
+		return false;
+
+	if (!m_analyzed || m_ordering_changed || !same_pattern(M)) {
+		if (!analyze_matrix(M))
+			return false;
+	}
+
+	return factor_matrix(M);
+}
+
+
+bool TaucsFactorization::refactor()
+{
+	if (m_matrix == NULL) {
+		std::cout << title() << "no matrix to factor" << std::endl;
+		return false;
+	}
+
+	if (m_matrix->row_dimension() != m_rows || m_matrix->column_dimension() != m_columns) {
+		std::cout << title() << "the dimensions of the matrix changed" << std::endl;
+		return false;
+	}
+
+	return factor(*m_matrix, m_mode);
+}
+
+
+void TaucsFactorization::release()
+{
+	free_analysis();
+	clear_updates();
+
+	m_normal_equations.clear();
+
+	m_matrix = NULL;
+	m_rows = 0;
+	m_columns = 0;
+}
+
+
+bool TaucsFactorization::solve(const std::vector<double>& rhs, std::vector<double>& result) const
+{
+	if (!is_factored()) {
+		std::cout << title() << "the matrix is not factored" << std::endl;
+		return false;
+	}
+
+	if (m_rows != rhs.size()) {
+		std::cout << title() << "num_row != rhs.size()" << std::endl;
+		return false;
+	}
+
+	// X
+	result.resize(m_columns);
+
+	//////////////////////////////////////////////////////////////////////////
+
+	double t0 = taucs_wtime();
+
+	if (m_in_core_lu.is_factored())
+		m_in_core_lu.solve(&(rhs[0]), &(result[0]));
+	else if (m_mode == SYMMETRIC_INDEFINITE) {
+		if (!m_ldlt.solve(&(rhs[0]), &(result[0]), &m_backward_error)) {
+			std::cout << title() << "the refinement did not converge (backward error " << m_backward_error << ")" << std::endl;
+			return false;
+		}
+	}
+	else if (m_mode == NON_SYMMETRIC) {
+		taucs_io_handle* LU = (taucs_io_handle*)m_lu;
+		double bytes_read = LU->bytes_read;
+		double bytes_written = LU->bytes_written;
+		double io_time = LU->read_time + LU->write_time;
+		int rc = taucs_ooc_solve_lu(LU, &(result[0]), (void*)&(rhs[0]));
+		m_statistics.bytes_read += LU->bytes_read - bytes_read;
+		m_statistics.bytes_written += LU->bytes_written - bytes_written;
+		m_statistics.io_time += LU->read_time + LU->write_time - io_time;
+		if (rc != TAUCS_SUCCESS) {
+			std::cout << title() << "solving failed" << std::endl;
+			return false;
+		}
+	}
+	else {
+		// the right side: b, or A^T*b for LEAST_SQUARES
+		const double* b = &(rhs[0]);
+		std::vector<double> AtB;
+		if (m_mode == LEAST_SQUARES) {
+			AtB.resize(m_columns);
+			m_normal_equations.multiply_transpose(&(rhs[0]), &(AtB[0]));
+			b = &(AtB[0]);
+		}
+
+		if (!solve_cholesky(b, &(result[0])))
+			return false;
+	}
+
+	++m_statistics.nb_solves;
+	m_statistics.solve_time += taucs_wtime() - t0;
+	return true;
+}
+
+
+bool TaucsFactorization::solve_normal_equations(const std::vector<double>& rhs, std::vector<double>& result) const
+{
+	if (!is_factored() || (m_mode != SYMMETRIC && m_mode != LEAST_SQUARES)) {
+		std::cout << title() << "no Cholesky factorization" << std::endl;
+		return false;
+	}
+
+	if (m_columns != rhs.size()) {
+		std::cout << title() << "num_col != rhs.size()" << std::endl;
+		return false;
+	}
+
+	result.resize(m_columns);
+
+	double t0 = taucs_wtime();
+	if (!solve_cholesky(&(rhs[0]), &(result[0])))
+		return false;
+
+	++m_statistics.nb_solves;
+	m_statistics.solve_time += taucs_wtime() - t0;
+	return true;
+}
+
+
+bool TaucsFactorization::solve_cholesky(const double* b, double* x) const
+{
+	// the updated (or loaded) factor is the compressed column one
+	if (m_updated || m_mapped_factor.is_open()) {
+		solve_llt(m_factor_ccs, 1, b, m_columns, x, m_columns, true);
+		return true;
+	}
+
+	// solve with the factor of P*A*P^T
+	int n = m_columns;
+	std::vector<double> PB(n), PX(n);
+	taucs_vec_permute(n, TAUCS_DOUBLE, (void*)b, &(PB[0]), (int*)&(m_perm[0]));
+	int rc = TAUCS_SUCCESS;
+	if (m_ooc_llt != NULL) {
+		taucs_io_handle* L = (taucs_io_handle*)m_ooc_llt;
+		double bytes_read = L->bytes_read;
+		double bytes_written = L->bytes_written;
+		double io_time = L->read_time + L->write_time;
+		rc = taucs_ooc_solve_llt(L, &(PX[0]), &(PB[0]));
+		m_statistics.bytes_read += L->bytes_read - bytes_read;
+		m_statistics.bytes_written += L->bytes_written - bytes_written;
+		m_statistics.io_time += L->read_time + L->write_time - io_time;
+	}
+	else
+		rc = taucs_supernodal_solve_llt(m_factor, &(PX[0]), &(PB[0]));
+	if (rc != TAUCS_SUCCESS) {
+		std::cout << title() << "solve failed" << std::endl;
+		return false;
+	}
+	taucs_vec_ipermute(n, TAUCS_DOUBLE, &(PX[0]), x, (int*)&(m_perm[0]));
+	return true;
+}
+
+
+bool TaucsFactorization::solve(const std::vector< std::vector<double> >& rhs,
+							   std::vector< std::vector<double> >& result) const
+{
+	for (unsigned int i=0; i<rhs.size(); ++i) {
+		if (m_rows != rhs[i].size()) {
+			std::cout << title() << "num_row != rhs.size()" << std::endl;
+			return false;
+		}	
+	}
+
+	result.resize(rhs.size());
+	for (unsigned int i=0; i<result.size(); ++i)
+		result[i].resize(m_columns);
+
+	// the vectors are copied by blocks (of one block per thread) into
+	// contiguous arrays
+	unsigned int chunk = RHS_BLOCK_SIZE * std::max(1, m_num_threads);
+	std::vector<double> B, X;
+	for (unsigned int first=0; first<rhs.size(); first+=chunk) {
+		unsigned int nb = std::min<unsigned int>(chunk, static_cast<unsigned int>(rhs.size()) - first);
+		B.resize(static_cast<std::size_t>(m_rows) * nb);
+		X.resize(static_cast<std::size_t>(m_columns) * nb);
+		for (unsigned int c=0; c<nb; ++c)
+			std::copy(rhs[first + c].begin(), rhs[first + c].end(), B.begin() + static_cast<std::size_t>(c) * m_rows);
+
+		if (!solve(nb, &(B[0]), m_rows, &(X[0]), m_columns))
+			return false;
+
+		for (unsigned int c=0; c<nb; ++c)
+			std::copy(X.begin() + static_cast<std::size_t>(c) * m_columns, X.begin() + static_cast<std::size_t>(c + 1) * m_columns, result[first + c].begin());
+	}
+	return true;
+}
+
+
+// Solve L*L^T*X = W for the compressed column factor L (diagonal first in 
+// each column) and the nb vectors of W, stored by rows (the nb values of row
+// i are contiguous): each element of L updates a whole row.
+static void solve_llt_block(const taucs_ccs_matrix* L, double* W, std::size_t nb)
+{
+	int n = L->n;
+
+	// W = L \ W
+	for (int j = 0; j < n; ++j) {
+		double* wj = W + j * nb;
+		double d = L->taucs_values[L->colptr[j]];
+		for (std::size_t c = 0; c < nb; ++c)
+			wj[c] /= d;
+		for (int p = L->colptr[j] + 1; p < L->colptr[j + 1]; ++p) {
+			double l = L->taucs_values[p];
+			double* wi = W + L->rowind[p] * nb;
+			for (std::size_t c = 0; c < nb; ++c)
+				wi[c] -= l * wj[c];
+		}
+	}
+
+	// W = L^T \ W
+	for (int j = n - 1; j >= 0; --j) {
+		double* wj = W + j * nb;
+		for (int p = L->colptr[j] + 1; p < L->colptr[j + 1]; ++p) {
+			double l = L->taucs_values[p];
+			const double* wi = W + L->rowind[p] * nb;
+			for (std::size_t c = 0; c < nb; ++c)
+				wj[c] -= l * wi[c];
+		}
+		double d = L->taucs_values[L->colptr[j]];
+		for (std::size_t c = 0; c < nb; ++c)
+			wj[c] /= d;
+	}
+}
+
+
+bool TaucsFactorization::solve(int nrhs, const double* B, int ldb, double* X, int ldx) const
+{
+	if (!is_factored()) {
+		std::cout << title() << "the matrix is not factored" << std::endl;
+		return false;
+	}
+
+	if (ldb < m_rows || ldx < m_columns) {
+		std::cout << title() << "ldb < num_row or ldx < num_col" << std::endl;
+		return false;
+	}
+
+	if (nrhs <= 0)
+		return true;
+
+	double t0 = taucs_wtime();
+
+	// each thread solves a range of the vectors with the shared factor
+	int num_threads = std::max(1, std::min(m_num_threads, nrhs));
+
+	if (m_in_core_lu.is_factored()) {
+		Parallel::for_each_range(num_threads, 0, nrhs, [&](int, int begin, int end) {
+			if (end > begin)
+				m_in_core_lu.solve(end - begin, B + begin * static_cast<std::size_t>(ldb), ldb, X + begin * static_cast<std::size_t>(ldx), ldx);
+		});
+	}
+	else if (m_mode == SYMMETRIC_INDEFINITE) {
+		std::vector<double> errors(num_threads, 0.0);
+		Parallel::for_each_range(num_threads, 0, nrhs, [&](int t, int begin, int end) {
+			if (end > begin)
+				m_ldlt.solve(end - begin, B + begin * static_cast<std::size_t>(ldb), ldb, X + begin * static_cast<std::size_t>(ldx), ldx, &errors[t]);
+		});
+		m_backward_error = 0;
+		for (int t = 0; t < num_threads; ++t) {
+			if (!(errors[t] <= m_backward_error))
+				m_backward_error = errors[t];
+		}
+		if (!(m_backward_error <= SparseLDLT::MAX_BACKWARD_ERROR)) {
+			std::cout << title() << "the refinement did not converge (backward error " << m_backward_error << ")" << std::endl;
+			return false;
+		}
+	}
+	else if (m_lu != NULL || m_ooc_llt != NULL) {
+		// the out-of-core factors can only be used vector by vector, and by a
+		// single thread (they are read from their file)
+		std::vector<double> b, x;
+		for (int c = 0; c < nrhs; ++c) {
+			b.assign(B + static_cast<std::size_t>(c) * ldb, B + static_cast<std::size_t>(c) * ldb + m_rows);
+			if (!solve(b, x))
+				return false;
+			std::copy(x.begin(), x.end(), X + static_cast<std::size_t>(c) * ldx);
+		}
+		return true;
+	}
+	else {
+		const taucs_ccs_matrix* L = factor_ccs();
+		if (L == NULL) {
+			std::cout << title() << "can not convert the factor" << std::endl;
+			return false;
+		}
+
+		Parallel::for_each_range(num_threads, 0, nrhs, [&](int, int begin, int end) {
+			if (end > begin)
+				solve_llt(L, end - begin, B + begin * static_cast<std::size_t>(ldb), ldb, X + begin * static_cast<std::size_t>(ldx), ldx);
+		});
+	}
+
+	m_statistics.nb_solves += nrhs;
+	m_statistics.solve_time += taucs_wtime() - t0;
+	return true;
+}
+
+
+void TaucsFactorization::solve_llt(const taucs_ccs_matrix* L, int nrhs, const double* B, int ldb, double* X, int ldx, 
+								   bool normal_equations) const
+{
+	int n = m_columns;
+	bool multiply_transpose = (m_mode == LEAST_SQUARES && !normal_equations);
+	std::vector<double> W(static_cast<std::size_t>(n) * std::min<int>(nrhs, RHS_BLOCK_SIZE));
+	std::vector<double> AtB(multiply_transpose ? n : 0);
+	for (int first = 0; first < nrhs; first += RHS_BLOCK_SIZE) {
+		std::size_t nb = std::min<int>(nrhs - first, RHS_BLOCK_SIZE);
+
+		// W = P*B (or P*A^T*B for LEAST_SQUARES)
+		for (std::size_t c = 0; c < nb; ++c) {
+			const double* b = B + (first + c) * static_cast<std::size_t>(ldb);
+			if (multiply_transpose) {
+				m_normal_equations.multiply_transpose(b, &(AtB[0]));
+				b = &(AtB[0]);
+			}
+			for (int k = 0; k < n; ++k)
+				W[k * nb + c] = b[m_perm[k]];
+		}
+
+		solve_llt_block(L, &(W[0]), nb);
+
+		// X = P^T*W
+		for (std::size_t c = 0; c < nb; ++c) {
+			double* x = X + (first + c) * static_cast<std::size_t>(ldx);
+			for (int k = 0; k < n; ++k)
+				x[m_perm[k]] = W[k * nb + c];
+		}
+	}
+}
+
+
+const taucs_ccs_matrix* TaucsFactorization::factor_ccs() const
+{
+	std::lock_guard<std::mutex> lock(m_factor_ccs_mutex);
+	if (m_factor_ccs != NULL)
+		return m_factor_ccs;
+
+	taucs_ccs_matrix* L = taucs_supernodal_factor_to_ccs(m_factor);
+	if (L == NULL)
+		return NULL;
+
+	// the diagonal first in each column
+	for (int j = 0; j < L->n; ++j) {
+		for (int p = L->colptr[j]; p < L->colptr[j + 1]; ++p) {
+			if (L->rowind[p] == j) {
+				std::swap(L->rowind[p], L->rowind[L->colptr[j]]);
+				std::swap(L->taucs_values[p], L->taucs_values[L->colptr[j]]);
+				break;
+			}
+		}
+	}
+
+	m_factor_ccs = L;
+	return m_factor_ccs;
+}
+
+
+bool TaucsFactorization::update(const TaucsMatrix& W)
+{
+	return update(W, 1.0);
+}
+
+
+bool TaucsFactorization::downdate(const TaucsMatrix& W)
+{
+	return update(W, -1.0);
+}
+
+
+bool TaucsFactorization::update(const TaucsMatrix& matrix, double sigma)
+{
+	if (!is_factored() || (m_mode != SYMMETRIC && m_mode != LEAST_SQUARES)) {
+		std::cout << title() << "no Cholesky factorization to update" << std::endl;
+		return false;
+	}
+
+	const taucs_ccs_matrix* W = matrix.get_taucs_matrix();
+	if (W == NULL) {
+		std::cout << title() << "can not create the TAUCS matrix" << std::endl;
+		return false;
+	}
+	if ((W->flags & TAUCS_SYMMETRIC) || W->m != m_columns) {
+		std::cout << title() << "W is symmetric or W.row_dimension() != num_col" << std::endl;
+		return false;
+	}
+
+	double t0 = taucs_wtime();
+
+	// the out-of-core factor is always refactored
+	bool in_place = (m_ooc_llt == NULL);
+	const taucs_ccs_matrix* L = in_place ? factor_ccs() : NULL;
+	if (in_place && L == NULL) {
+		std::cout << title() << "can not convert the factor" << std::endl;
+		return false;
+	}
+
+	// the loaded factor is read-only: update a copy
+	if (in_place && m_mapped_factor.is_open()) {
+		taucs_ccs_matrix* copy = TaucsUtil::MatrixCopy(L);
+		if (copy == NULL) {
+			std::cout << title() << "can not copy the factor" << std::endl;
+			return false;
+		}
+		delete m_factor_ccs;
+		m_mapped_factor.close();
+		m_factor_ccs = copy;
+		L = copy;
+	}
+
+	// the elimination tree of L (the first row below the diagonal of each
+	// column), and the cost of its factorization
+	int n = m_columns;
+	if (in_place && m_factor_parent.empty()) {
+		m_factor_parent.assign(n, -1);
+		m_factorization_cost = 0;
+		for (int j = 0; j < n; ++j) {
+			double count = L->colptr[j + 1] - L->colptr[j];
+			m_factorization_cost += count * count;
+			for (int p = L->colptr[j] + 1; p < L->colptr[j + 1]; ++p) {
+				int i = L->rowind[p];
+				if (m_factor_parent[j] == -1 || i < m_factor_parent[j])
+					m_factor_parent[j] = i;
+			}
+		}
+		m_update_values.assign(n, 0.0);
+		m_update_mark.assign(n, -1);
+		m_update_stamp = 0;
+	}
+
+	// The first step f of each column w of W. The update is done in place if
+	// the steps of the rows of w are all in the pattern of column f of L (then
+	// the updated factor has the pattern of L: the rows of each column on the
+	// path from f are in the pattern of the next one), and if the columns of
+	// L on the paths have fewer nonzeros than the operations of the
+	// factorization.
+	std::vector<int> first(W->n, -1);
+	double cost = 0;
+	for (int c = 0; c < W->n && in_place; ++c) {
+		if (W->colptr[c] == W->colptr[c + 1])
+			continue;
+		int f = n;
+		for (int p = W->colptr[c]; p < W->colptr[c + 1]; ++p)
+			f = std::min(f, m_invperm[W->rowind[p]]);
+		first[c] = f;
+
+		int stamp = m_update_stamp++;
+		for (int p = L->colptr[f]; p < L->colptr[f + 1]; ++p)
+			m_update_mark[L->rowind[p]] = stamp;
+		for (int p = W->colptr[c]; p < W->colptr[c + 1]; ++p) {
+			if (m_update_mark[m_invperm[W->rowind[p]]] != stamp)
+				in_place = false;
+		}
+		for (int j = f; j != -1; j = m_factor_parent[j])
+			cost += L->colptr[j + 1] - L->colptr[j];
+	}
+	if (cost > m_factorization_cost)
+		in_place = false;
+
+	// the columns of W are kept for a later factorization of the updated matrix
+	if (m_updates_colptr.empty())
+		m_updates_colptr.push_back(0);
+	for (int c = 0; c < W->n; ++c) {
+		m_updates_rowind.insert(m_updates_rowind.end(), W->rowind + W->colptr[c], W->rowind + W->colptr[c + 1]);
+		m_updates_values.insert(m_updates_values.end(), W->taucs_values + W->colptr[c], W->taucs_values + W->colptr[c + 1]);
+		m_updates_colptr.push_back(static_cast<int>(m_updates_rowind.size()));
+		m_updates_sigma.push_back(sigma);
+	}
+
+	if (in_place) {
+		m_updated = true;
+		for (int c = 0; c < W->n && in_place; ++c) {
+			if (first[c] >= 0 && !update_column(W, c, first[c], sigma))
+				in_place = false;		// the factor is lost: factor the matrix
+		}
+	}
+
+	if (!in_place)
+		return factor_updated_matrix();
+
+	m_statistics.nb_updates += W->n;
+	m_statistics.update_time += taucs_wtime() - t0;
+	return true;
+}
+
+
+bool TaucsFactorization::update_column(const taucs_ccs_matrix* W, int c, int first, double sigma)
+{
+	taucs_ccs_matrix* L = m_factor_ccs;
+	double* w = &(m_update_values[0]);
+	for (int p = W->colptr[c]; p < W->colptr[c + 1]; ++p)
+		w[m_invperm[W->rowind[p]]] = W->taucs_values[p];
+
+	// L*L^T + sigma*w*w^T, column by column along the path (the diagonal is
+	// first in each column)
+	bool ok = true;
+	double beta = 1;
+	for (int j = first; j != -1; j = m_factor_parent[j]) {
+		int p = L->colptr[j];
+		double alpha = w[j] / L->taucs_values[p];
+		double beta2 = beta * beta + sigma * alpha * alpha;
+		if (beta2 <= 0) {
+			ok = false;
+			break;
+		}
+		beta2 = std::sqrt(beta2);
+		double delta = (sigma > 0) ? beta / beta2 : beta2 / beta;
+		double gamma = sigma * alpha / (beta2 * beta);
+		L->taucs_values[p] = delta * L->taucs_values[p] + ((sigma > 0) ? gamma * w[j] : 0);
+		beta = beta2;
+		for (++p; p < L->colptr[j + 1]; ++p) {
+			int i = L->rowind[p];
+			double w1 = w[i];
+			double w2 = w1 - alpha * L->taucs_values[p];
+			w[i] = w2;
+			L->taucs_values[p] = delta * L->taucs_values[p] + gamma * ((sigma > 0) ? w1 : w2);
+		}
+	}
+
+	// w is zero again (its nonzeros are in the columns of the path)
+	for (int j = first; j != -1; j = m_factor_parent[j]) {
+		for (int p = L->colptr[j]; p < L->colptr[j + 1]; ++p)
+			w[L->rowind[p]] = 0;
+	}
+
+	return ok;
+}
+
+
+bool TaucsFactorization::factor_updated_matrix()
+{
+	// the matrix of the last factorization
+	const taucs_ccs_matrix* M = m_updated_matrix;
+	if (M == NULL && m_mode == LEAST_SQUARES) {
+		// A^T*A is not computed by load()
+		if (!m_normal_equations.is_computed() && !m_normal_equations.compute(*m_matrix)) {
+			std::cout << title() << "can not compute A^T*A" << std::endl;
+			return false;
+		}
+		M = m_normal_equations.matrix().get_taucs_matrix();
+	}
+	else if (M == NULL)
+		M = m_matrix->get_taucs_matrix();
+	if (M == NULL) {
+		std::cout << title() << "can not create the TAUCS matrix" << std::endl;
+		return false;
+	}
+
+	// M plus sigma*w*w^T for the columns w of the updates (lower triangle)
+	std::vector<int> rows(M->rowind, M->rowind + M->colptr[M->n]);
+	std::vector<int> cols(rows.size());
+	std::vector<double> values(M->taucs_values, M->taucs_values + M->colptr[M->n]);
+	for (int j = 0; j < M->n; ++j)
+		std::fill(cols.begin() + M->colptr[j], cols.begin() + M->colptr[j + 1], j);
+	for (std::size_t c = 0; c < m_updates_sigma.size(); ++c) {
+		for (int p = m_updates_colptr[c]; p < m_updates_colptr[c + 1]; ++p) {
+			for (int q = m_updates_colptr[c]; q < m_updates_colptr[c + 1]; ++q) {
+				if (m_updates_rowind[p] >= m_updates_rowind[q]) {
+					rows.push_back(m_updates_rowind[p]);
+					cols.push_back(m_updates_rowind[q]);
+					values.push_back(m_updates_sigma[c] * m_updates_values[p] * m_updates_values[q]);
+				}
+			}
+		}
+	}
+	taucs_ccs_matrix* U = TaucsUtil::CreateTaucsMatrixFromTriplets(M->n, M->n, static_cast<int>(values.size()), &(rows[0]), &(cols[0]), &(values[0]),
+		TAUCS_DOUBLE | TAUCS_TRIANGULAR | TAUCS_SYMMETRIC | TAUCS_LOWER);
+	if (U == NULL) {
+		std::cout << title() << "can not create the updated matrix" << std::endl;
+		return false;
+	}
+
+	free_numeric();
+	bool ok = (same_pattern(U) || analyze_matrix(U)) && factor_matrix(U);
+
+	// the updated matrix replaces the previous one
+	clear_updates();
+	m_updated_matrix = U;
+	return ok;
+}
+
+
+void TaucsFactorization::clear_updates()
+{
+	if (m_updated_matrix != NULL) {
+		taucs_ccs_free(m_updated_matrix);
+		m_updated_matrix = NULL;
+	}
+	m_updates_colptr.clear();
+	m_updates_rowind.clear();
+	m_updates_values.clear();
+	m_updates_sigma.clear();
+}
+
+
+// The header of the files of save(), followed by the arrays of the factor at
+// the given offsets (multiples of 8 bytes): perm[n], colptr[n+1], rowind[nnz]
+// and values[nnz] of the compressed column factor, the diagonal first in each
+// column
+struct FactorFileHeader {
+	char				magic[8];		// "TAUCSLLT"
+	unsigned int		version;
+	unsigned int		byte_order;		// FACTOR_FILE_BYTE_ORDER, as written by the machine
+	int					mode;
+	int					rows;
+	int					columns;
+	int					nnz;			// of the factor
+	unsigned long long	fingerprint;	// of A
+	unsigned long long	offsets[4];		// of perm, colptr, rowind and values
+	unsigned long long	file_size;
+};
+
+static const char FACTOR_FILE_MAGIC[8] = { 'T', 'A', 'U', 'C', 'S', 'L', 'L', 'T' };
+static const unsigned int FACTOR_FILE_VERSION = 1;
+static const unsigned int FACTOR_FILE_BYTE_ORDER = 0x01020304;
+
+
+// Write size bytes at offset, after zeros from the current position
+static bool write_at(std::ofstream& out, unsigned long long& position, unsigned long long offset, const void* data, std::size_t size)
+{
+	static const char zeros[8] = { 0 };
+	out.write(zeros, static_cast<std::streamsize>(offset - position));
+	out.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+	position = offset + size;
+	return !out.fail();
+}
+
+
+bool TaucsFactorization::save(const std::string& file_name) const
+{
+	if (!is_factored() || (m_mode != SYMMETRIC && m_mode != LEAST_SQUARES)) {
+		std::cout << title() << "no Cholesky factorization to save" << std::endl;
+		return false;
+	}
+	if (m_ooc_llt != NULL || m_updated || m_updated_matrix != NULL) {
+		std::cout << title() << "the factor is out-of-core or updated" << std::endl;
+		return false;
+	}
+
+	const taucs_ccs_matrix* L = factor_ccs();
+	if (L == NULL) {
+		std::cout << title() << "can not convert the factor" << std::endl;
+		return false;
+	}
+
+	int n = m_columns;
+	int nnz = L->colptr[n];
+
+	FactorFileHeader header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, FACTOR_FILE_MAGIC, sizeof(header.magic));
+	header.version = FACTOR_FILE_VERSION;
+	header.byte_order = FACTOR_FILE_BYTE_ORDER;
+	header.mode = m_mode;
+	header.rows = m_rows;
+	header.columns = m_columns;
+	header.nnz = nnz;
+	header.fingerprint = m_fingerprint;
+
+	unsigned long long sizes[4] = { n * sizeof(int), (n + 1) * sizeof(int), nnz * sizeof(int), nnz * sizeof(double) };
+	unsigned long long offset = sizeof(header);
+	for (int i = 0; i < 4; ++i) {
+		offset = (offset + 7) / 8 * 8;
+		header.offsets[i] = offset;
+		offset += sizes[i];
+	}
+	header.file_size = offset;
+
+	// the temporary file is renamed once complete
+	std::ostringstream temporary;
+	temporary << file_name << "." << getpid() << ".tmp";
+	std::ofstream out(temporary.str().c_str(), std::ios::binary | std::ios::trunc);
+	if (!out) {
+		std::cout << title() << "can not create " << temporary.str() << std::endl;
+		return false;
+	}
+
+	unsigned long long position = 0;
+	bool ok = write_at(out, position, 0, &header, sizeof(header)) &&
+		write_at(out, position, header.offsets[0], &(m_perm[0]), sizes[0]) &&
+		write_at(out, position, header.offsets[1], L->colptr, sizes[1]) &&
+		write_at(out, position, header.offsets[2], L->rowind, sizes[2]) &&
+		write_at(out, position, header.offsets[3], L->taucs_values, sizes[3]);
+	out.close();
+	if (!ok || out.fail()) {
+		std::cout << title() << "can not write " << temporary.str() << std::endl;
+		std::remove(temporary.str().c_str());
+		return false;
+	}
+
+#ifdef _WIN32
+	std::remove(file_name.c_str());		// rename does not replace a file
+#endif
+	if (std::rename(temporary.str().c_str(), file_name.c_str()) != 0) {
+		std::cout << title() << "can not rename " << temporary.str() << " to " << file_name << std::endl;
+		std::remove(temporary.str().c_str());
+		return false;
+	}
+	return true;
+}
+
+
+bool TaucsFactorization::load(const std::string& file_name, const TaucsMatrix& matrix)
+{
+	release();
+
+	const taucs_ccs_matrix* A = matrix.get_taucs_matrix();
+	if (A == NULL) {
+		std::cout << title() << "can not create the TAUCS matrix" << std::endl;
+		return false;
+	}
+
+	if (!m_mapped_factor.open(file_name)) {
+		std::cout << title() << "can not map " << file_name << std::endl;
+		return false;
+	}
+	const char* data = m_mapped_factor.data();
+	std::size_t size = m_mapped_factor.size();
+
+	// The header, and the arrays in the file
+	FactorFileHeader header;
+	bool valid = (size >= sizeof(header));
+	if (valid) {
+		std::memcpy(&header, data, sizeof(header));
+		valid = std::memcmp(header.magic, FACTOR_FILE_MAGIC, sizeof(header.magic)) == 0 &&
+			header.version == FACTOR_FILE_VERSION && header.byte_order == FACTOR_FILE_BYTE_ORDER &&
+			(header.mode == SYMMETRIC || header.mode == LEAST_SQUARES) && header.file_size == size &&
+			header.columns > 0 && header.nnz >= header.columns;
+	}
+	if (valid) {
+		unsigned long long n = header.columns;
+		unsigned long long nnz = header.nnz;
+		unsigned long long sizes[4] = { n * sizeof(int), (n + 1) * sizeof(int), nnz * sizeof(int), nnz * sizeof(double) };
+		for (int i = 0; i < 4; ++i) {
+			if (header.offsets[i] % 8 != 0 || header.offsets[i] < sizeof(header) || header.offsets[i] > size || sizes[i] > size - header.offsets[i])
+				valid = false;
+		}
+	}
+	if (!valid) {
+		std::cout << title() << file_name << " is not a factorization file of this version" << std::endl;
+		m_mapped_factor.close();
+		return false;
+	}
+
+	// The matrix it was saved for
+	if (!check_dimensions(matrix, static_cast<Mode>(header.mode)) ||
+		header.rows != matrix.row_dimension() || header.columns != matrix.column_dimension()) {
+		std::cout << title() << file_name << " was saved for a matrix of other dimensions" << std::endl;
+		m_mapped_factor.close();
+		return false;
+	}
+	if (header.fingerprint != TaucsUtil::Fingerprint(A)) {
+		std::cout << title() << file_name << " was saved for another matrix" << std::endl;
+		m_mapped_factor.close();
+		return false;
+	}
+
+	int n = header.columns;
+	const int* perm = reinterpret_cast<const int*>(data + header.offsets[0]);
+	const int* colptr = reinterpret_cast<const int*>(data + header.offsets[1]);
+	const int* rowind = reinterpret_cast<const int*>(data + header.offsets[2]);
+	const double* values = reinterpret_cast<const double*>(data + header.offsets[3]);
+
+	// The ordering must be a permutation, and each column of the factor must
+	// start with its diagonal, followed by rows below it (the solves index
+	// the vectors with them; the values are only read by the solves)
+	std::vector<int> invperm(n, -1);
+	valid = (colptr[0] == 0 && colptr[n] == header.nnz);
+	for (int k = 0; k < n && valid; ++k) {
+		valid = perm[k] >= 0 && perm[k] < n && invperm[perm[k]] == -1 &&
+			colptr[k] < colptr[k + 1] && colptr[k + 1] <= header.nnz && rowind[colptr[k]] == k;
+		for (int p = colptr[k] + 1; p < colptr[k + 1] && valid; ++p)
+			valid = rowind[p] > k && rowind[p] < n;
+		if (valid)
+			invperm[perm[k]] = k;
+	}
+	if (!valid) {
+		std::cout << title() << file_name << " is corrupted" << std::endl;
+		m_mapped_factor.close();
+		return false;
+	}
+
+	// A^T*A is computed only if an update refactors it
+	m_mode = static_cast<Mode>(header.mode);
+	if (m_mode == LEAST_SQUARES && !m_normal_equations.set_transpose(matrix)) {
+		m_mapped_factor.close();
+		return false;
+	}
+
+	m_matrix = &matrix;
+	m_rows = header.rows;
+	m_columns = header.columns;
+	m_perm.assign(perm, perm + n);
+	m_invperm.swap(invperm);
+	m_fingerprint = header.fingerprint;
+
+	// the factor is read-only: the arrays are never modified or freed
+	m_factor_ccs = new taucs_ccs_matrix();
+	m_factor_ccs->n = n;
+	m_factor_ccs->m = n;
+	m_factor_ccs->flags = TAUCS_DOUBLE | TAUCS_TRIANGULAR | TAUCS_LOWER;
+	m_factor_ccs->colptr = const_cast<int*>(colptr);
+	m_factor_ccs->rowind = const_cast<int*>(rowind);
+	m_factor_ccs->taucs_values = const_cast<double*>(values);
+	m_factored = true;
+	return true;
+}
+
+
+bool TaucsFactorization::check_dimensions(const TaucsMatrix& matrix, Mode mode) const
+{
+	int num_row = matrix.row_dimension();
+	int num_col = matrix.column_dimension();
+
+	if (mode == LEAST_SQUARES) {
+		if (num_row < num_col) {
+			std::cout << title() << "num_row < num_col" << std::endl;
+			return false;
+		}
+	}
+	else if (num_row != num_col) {
+		std::cout << title() << "num_row != num_col" << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+
+const taucs_ccs_matrix* TaucsFactorization::matrix_to_factor(const TaucsMatrix& matrix)
+{
+	// A
+	const taucs_ccs_matrix* A = matrix.get_taucs_matrix();
+	if (A == NULL) {
+		std::cout << title() << "can not create the TAUCS matrix" << std::endl;
+		return NULL;
+	}
+
+	if (m_mode != LEAST_SQUARES)
+		return A;
+
+	// A^T*A
+	double t0 = taucs_wtime();
+
+	if (!m_normal_equations.compute(matrix)) {
+		std::cout << title() << "can not compute A^T * A" << std::endl;
+		return NULL;
+	}
+	const taucs_ccs_matrix* AtA = m_normal_equations.matrix().get_taucs_matrix();
+
+	m_statistics.factor_time += taucs_wtime() - t0;
+	return AtA;
+}
+
+
+bool TaucsFactorization::same_pattern(const taucs_ccs_matrix* M) const
+{
+	int n = M->n;
+	if (m_pattern_colptr.size() != n + 1)
+		return false;
+
+	return std::equal(M->colptr, M->colptr + n + 1, m_pattern_colptr.begin()) &&
+		std::equal(M->rowind, M->rowind + M->colptr[n], m_pattern_rowind.begin());
+}
+
+
+bool TaucsFactorization::analyze_matrix(const taucs_ccs_matrix* M)
+{
+	free_analysis();
+
+	double t0 = taucs_wtime();
+
+	// ordering (column ordering for the LU factorization)
+	m_selected_ordering = (m_ordering == AUTO_ORDERING) ? select_ordering(M) : m_ordering;
+	if (m_selected_ordering == DEFAULT_ORDERING) {
+		if (m_mode == NON_SYMMETRIC)
+			m_selected_ordering = COLAMD;
+		else {
+			// metis, if TAUCS was built with it
+			m_selected_ordering = compute_ordering(M, METIS, m_perm, m_invperm) ? METIS : AMD;
+		}
+	}
+	if (m_perm.empty() && !compute_ordering(M, m_selected_ordering, m_perm, m_invperm)) {
+		std::cout << title() << "ordering failed" << std::endl;
+		free_analysis();
+		return false;
+	}
+	m_ordering_changed = false;
+
+	// symbolic factorization of P*A*P^T
+	if (m_mode == SYMMETRIC_INDEFINITE) {
+		if (!(M->flags & TAUCS_SYMMETRIC)) {
+			std::cout << title() << "the matrix is not symmetric (lower triangle)" << std::endl;
+			free_analysis();
+			return false;
+		}
+		if (!m_ldlt.analyze(M, &(m_perm[0]))) {
+			std::cout << title() << "symbolic factorization failed (more than 2^31-1 nonzeros)" << std::endl;
+			free_analysis();
+			return false;
+		}
+	}
+	else if (m_mode == NON_SYMMETRIC) {
+		// the size of the LU factor with diagonal pivots: L and U^T have the 
+		// pattern of the Cholesky factor of P*(A+A^T)*P^T (partial pivoting can
+		// make it larger, see factor_matrix()). If A + A^T has too many nonzeros,
+		// the factor is at least as large as A.
+		double nnz_LU = M->colptr[M->n];
+		taucs_ccs_matrix* S = TaucsUtil::CreateSymmetricPattern(M);
+		if (S != NULL) {
+			taucs_ccs_matrix* PSPT = taucs_ccs_permute_symmetrically(S, &(m_perm[0]), &(m_invperm[0]));
+			taucs_ccs_free(S);
+			if (PSPT == NULL) {
+				std::cout << title() << "can not permute the matrix" << std::endl;
+				free_analysis();
+				return false;
+			}
+			double nnz_L = 0, flops = 0;
+			TaucsUtil::CholeskyFillEstimate(PSPT, &nnz_L, &flops);
+			taucs_ccs_free(PSPT);
+			nnz_LU = std::max(nnz_LU, 2 * nnz_L - M->n);
+		}
+		m_predicted_factor_size = nnz_LU * SparseLU::bytes_per_nonzero();
+	}
+	else {
+		taucs_ccs_matrix* PAPT = taucs_ccs_permute_symmetrically((taucs_ccs_matrix*)M, &(m_perm[0]), &(m_invperm[0]));
+		if (PAPT == NULL) {
+			std::cout << title() << "can not permute the matrix" << std::endl;
+			free_analysis();
+			return false;
+		}
+
+		// the size of the factor (values and row indices), and the in-core
+		// symbolic factorization only if it fits the memory budget (it is
+		// computed by the factorization otherwise)
+		double nnz_L = 0, flops = 0;
+		TaucsUtil::CholeskyFillEstimate(PAPT, &nnz_L, &flops);
+		m_predicted_factor_size = nnz_L * (sizeof(double) + sizeof(int));
+		bool out_of_core = m_force_out_of_core || m_predicted_factor_size > available_memory();
+		m_factor = out_of_core ? NULL : taucs_ccs_factor_llt_symbolic(PAPT);
+		taucs_ccs_free(PAPT);
+		if (!out_of_core && m_factor == NULL) {
+			std::cout << title() << "symbolic factorization failed" << std::endl;
+			free_analysis();
+			return false;
+		}
+	}
+
+	m_pattern_colptr.assign(M->colptr, M->colptr + M->n + 1);
+	m_pattern_rowind.assign(M->rowind, M->rowind + M->colptr[M->n]);
+	m_analyzed = true;
+
+	++m_statistics.nb_analyses;
+	m_statistics.analyze_time += taucs_wtime() - t0;
+	return true;
+}
+
+
+bool TaucsFactorization::factor_matrix(const taucs_ccs_matrix* M)
+{
+	double t0 = taucs_wtime();
+
+	if (m_mode == NON_SYMMETRIC) {
+		// In-core if the factor predicted by the analysis fits the memory 
+		// budget, out-of-core otherwise.
+		// Note: the prediction assumes diagonal pivots. If partial pivoting 
+		// makes the factor outgrow the budget, the in-core factorization stops
+		// and the out-of-core one starts again from scratch: the work done 
+		// in-core (up to a whole factorization) is lost.
+		double budget = available_memory();
+		if (!m_force_out_of_core && m_predicted_factor_size <= budget) {
+			SparseLU::Status status = m_in_core_lu.factor(M, &(m_perm[0]), budget);
+			if (status == SparseLU::SINGULAR) {
+				std::cout << title() << "factorization failed (singular matrix)" << std::endl;
+				return false;
+			}
+		}
+
+		if (!m_in_core_lu.is_factored()) {
+			std::string basename = scratch_file_name();
+			taucs_io_handle* LU = taucs_io_create_multifile(const_cast<char*>(basename.c_str()));
+			if (LU == NULL) {
+				std::cout << title() << "can not create multifile " << basename << std::endl;
+				return false;
+			}
+
+			// factorization
+			int memory_mb = int(budget / 1048576.0);
+			int rc = taucs_ooc_factor_lu((taucs_ccs_matrix*)M, &(m_perm[0]), LU, memory_mb * 1048576.0);
+			m_statistics.bytes_read += LU->bytes_read;
+			m_statistics.bytes_written += LU->bytes_written;
+			m_statistics.io_time += LU->read_time + LU->write_time;
+			if (rc != TAUCS_SUCCESS) {
+				std::cout << title() << "factorization failed" << std::endl;
+				taucs_io_delete(LU);
+				return false;
+			}
+			m_lu = LU;
+		}
+	}
+	else if (m_mode == SYMMETRIC_INDEFINITE) {
+		if (!m_ldlt.factor(M, m_pivot_tolerance)) {
+			std::cout << title() << "factorization failed (zero matrix or pivot not finite)" << std::endl;
+			return false;
+		}
+	}
+	else {
+		taucs_ccs_matrix* PAPT = taucs_ccs_permute_symmetrically((taucs_ccs_matrix*)M, &(m_perm[0]), &(m_invperm[0]));
+		if (PAPT == NULL) {
+			std::cout << title() << "can not permute the matrix" << std::endl;
+			return false;
+		}
+
+		// Out-of-core if the predicted factor does not fit the memory budget
+		double budget = available_memory();
+		if (m_force_out_of_core || m_predicted_factor_size > budget) {
+			std::string basename = scratch_file_name();
+			taucs_io_handle* L = taucs_io_create_multifile(const_cast<char*>(basename.c_str()));
+			if (L == NULL) {
+				std::cout << title() << "can not create multifile " << basename << std::endl;
+				taucs_ccs_free(PAPT);
+				return false;
+			}
+
+			int memory_mb = int(budget / 1048576.0);
+			int rc = taucs_ooc_factor_llt(PAPT, L, memory_mb * 1048576.0);
+			taucs_ccs_free(PAPT);
+			m_statistics.bytes_read += L->bytes_read;
+			m_statistics.bytes_written += L->bytes_written;
+			m_statistics.io_time += L->read_time + L->write_time;
+			if (rc != TAUCS_SUCCESS) {
+				std::cout << title() << "factorization failed" << std::endl;
+				taucs_io_delete(L);
+				return false;
+			}
+			m_ooc_llt = L;
+		}
+		else {
+			// the analysis skips the symbolic factorization of a factor 
+			// predicted out-of-core (e.g., before the budget changed)
+			if (m_factor == NULL)
+				m_factor = taucs_ccs_factor_llt_symbolic(PAPT);
+			if (m_factor == NULL) {
+				std::cout << title() << "symbolic factorization failed" << std::endl;
+				taucs_ccs_free(PAPT);
+				return false;
+			}
+
+			int rc = taucs_ccs_factor_llt_numeric(PAPT, m_factor);
+			taucs_ccs_free(PAPT);
+			if (rc != TAUCS_SUCCESS) {
+				std::cout << title() << "factorization failed" << std::endl;
+				taucs_supernodal_factor_free_numeric(m_factor);
+				return false;
+			}
+
+			// the fingerprint of A (not A^T*A) for save(): A may change
+			// before the factorization is saved
+			const taucs_ccs_matrix* A = m_matrix->get_taucs_matrix();
+			m_fingerprint = (A != NULL) ? TaucsUtil::Fingerprint(A) : 0;
+		}
+	}
+
+	m_factored = true;
+
+	++m_statistics.nb_factorizations;
+	m_statistics.factor_time += taucs_wtime() - t0;
+	return true;
+}
+
+
+void TaucsFactorization::set_ordering(Ordering ordering)
+{
+	m_ordering = ordering;
+	m_user_perm.clear();
+	m_ordering_changed = true;
+}
+
+
+void TaucsFactorization::set_ordering(const std::vector<int>& perm)
+{
+	m_ordering = USER_ORDERING;
+	m_user_perm = perm;
+	m_ordering_changed = true;
+}
+
+
+const char* TaucsFactorization::ordering_name(Ordering ordering)
+{
+	switch (ordering) {
+	case DEFAULT_ORDERING:	return "default";
+	case AUTO_ORDERING:		return "auto";
+	case AMD:				return "amd";
+	case MD:				return "md";
+	case MMD:				return "mmd";
+	case GENMMD:			return "genmmd";
+	case COLAMD:			return "colamd";
+	case METIS:				return "metis";
+	case IDENTITY:			return "identity";
+	case USER_ORDERING:		return "user";
+	}
+	return "unknown";
+}
+
+
+bool TaucsFactorization::compute_ordering(const taucs_ccs_matrix* M, Ordering ordering, 
+										  std::vector<int>& perm, std::vector<int>& invperm) const
+{
+	int n = M->n;
+	perm.clear();
+	invperm.clear();
+
+	if (ordering == USER_ORDERING) {
+		if (m_user_perm.size() != n) {
+			std::cout << title() << "the size of the user ordering is not " << n << std::endl;
+			return false;
+		}
+		perm = m_user_perm;
+	}
+	else if (ordering == IDENTITY) {
+		perm.resize(n);
+		for (int i = 0; i < n; ++i)
+			perm[i] = i;
+	}
+	else if (ordering == COLAMD && m_mode != NON_SYMMETRIC) {
+		std::cout << title() << "colamd is a column ordering for the LU factorization" << std::endl;
+		return false;
+	}
+	else {
+		// The symmetric orderings of a non-symmetric matrix are computed on the
+		// pattern of A + A^T
+		taucs_ccs_matrix* S = NULL;
+		if (ordering != COLAMD && m_mode == NON_SYMMETRIC) {
+			S = TaucsUtil::CreateSymmetricPattern(M);
+			if (S == NULL)
+				return false;
+		}
+
+		int* taucs_perm = NULL;
+		int* taucs_invperm = NULL;
+		taucs_ccs_order((taucs_ccs_matrix*)(S != NULL ? S : M), &taucs_perm, &taucs_invperm, (char*)ordering_name(ordering));
+		if (taucs_perm != NULL && taucs_invperm != NULL)
+			perm.assign(taucs_perm, taucs_perm + n);
+		taucs_free(taucs_perm);
+		taucs_free(taucs_invperm);
+		if (S != NULL)
+			taucs_ccs_free(S);
+	}
+
+	if (perm.empty())
+		return false;
+
+	// check the permutation, and invert it
+	invperm.assign(n, -1);
+	for (int i = 0; i < n; ++i) {
+		if (perm[i] < 0 || perm[i] >= n || invperm[perm[i]] != -1) {
+			std::cout << title() << "invalid ordering" << std::endl;
+			perm.clear();
+			invperm.clear();
+			return false;
+		}
+		invperm[perm[i]] = i;
+	}
+
+	return true;
+}
+
+
+TaucsFactorization::Ordering TaucsFactorization::select_ordering(const taucs_ccs_matrix* M)
+{
+	m_candidates.clear();
+
+	// The fill of the Cholesky factorization of P*A*P^T, or of the LU 
+	// factorization of A*P with diagonal pivots (P*(A+A^T)*P^T)
+	taucs_ccs_matrix* S = (m_mode == NON_SYMMETRIC) ? TaucsUtil::CreateSymmetricPattern(M) : NULL;
+	if (m_mode == NON_SYMMETRIC && S == NULL)
+		return DEFAULT_ORDERING;
+
+	static const Ordering symmetric_candidates[] = { AMD, MMD, GENMMD, METIS };
+	static const Ordering non_symmetric_candidates[] = { COLAMD, AMD, METIS };
+	const Ordering* candidates = (m_mode == NON_SYMMETRIC) ? non_symmetric_candidates : symmetric_candidates;
+	int nb_candidates = (m_mode == NON_SYMMETRIC) ? 3 : 4;
+
+	int best = -1;
+	for (int c = 0; c < nb_candidates; ++c) {
+		std::vector<int> perm, invperm;
+		if (!compute_ordering(M, candidates[c], perm, invperm))
+			continue;		// e.g., TAUCS was built without metis
+
+		taucs_ccs_matrix* PAPT = taucs_ccs_permute_symmetrically((taucs_ccs_matrix*)(S != NULL ? S : M), &(perm[0]), &(invperm[0]));
+		if (PAPT == NULL)
+			continue;
+		OrderingCandidate candidate;
+		candidate.ordering = candidates[c];
+		TaucsUtil::CholeskyFillEstimate(PAPT, &candidate.nnz_L, &candidate.flops);
+		taucs_ccs_free(PAPT);
+
+		// the smallest factor, then the fewest operations
+		if (best < 0 || candidate.nnz_L < m_candidates[best].nnz_L || 
+			(candidate.nnz_L == m_candidates[best].nnz_L && candidate.flops < m_candidates[best].flops)) 
+		{
+			best = static_cast<int>(m_candidates.size());
+			m_perm.swap(perm);
+			m_invperm.swap(invperm);
+		}
+		m_candidates.push_back(candidate);
+	}
+
+	if (S != NULL)
+		taucs_ccs_free(S);
+
+	return (best < 0) ? DEFAULT_ORDERING : m_candidates[best].ordering;
+}
+
+
+double TaucsFactorization::available_memory() const
+{
+	return (m_memory_budget < 0) ? taucs_available_memory_size() : m_memory_budget;
+}
+
+
+std::string TaucsFactorization::scratch_file_name() const
+{
+	// The process id and a counter of the factorizations of the process
+	static std::atomic<unsigned int> counter(0);
+	std::ostringstream name;
+	if (!m_scratch_directory.empty()) {
+		name << m_scratch_directory;
+		char last = m_scratch_directory[m_scratch_directory.size() - 1];
+		if (last != '/' && last != '\\')
+			name << '/';
+	}
+	name << "taucs.L." << getpid() << "." << counter++;
+	return name.str();
+}
+
+
+void TaucsFactorization::free_numeric()
+{
+	if (!m_factored)
+		return;
+
+	if (m_factor != NULL)
+		taucs_supernodal_factor_free_numeric(m_factor);
+
+	if (m_factor_ccs != NULL) {
+		if (m_mapped_factor.is_open())
+			delete m_factor_ccs;		// its arrays are in the mapped file
+		else
+			taucs_ccs_free(m_factor_ccs);
+		m_factor_ccs = NULL;
+	}
+	m_mapped_factor.close();
+
+	m_in_core_lu.clear();
+	m_ldlt.clear_factor();
+	m_backward_error = 0;
+
+	m_factor_parent.clear();
+	m_updated = false;
+
+	// delete the temporal multifile
+	if (m_lu != NULL) {
+		int delete_rc = taucs_io_delete((taucs_io_handle*)m_lu);
+		if (delete_rc != TAUCS_SUCCESS)
+			std::cout << title() << "delete multifile file failed" << std::endl;
+		m_lu = NULL;
+	}
+	if (m_ooc_llt != NULL) {
+		int delete_rc = taucs_io_delete((taucs_io_handle*)m_ooc_llt);
+		if (delete_rc != TAUCS_SUCCESS)
+			std::cout << title() << "delete multifile file failed" << std::endl;
+		m_ooc_llt = NULL;
+	}
+
+	m_factored = false;
+}
+
+
+void TaucsFactorization::free_analysis()
+{
+	free_numeric();
+
+	if (m_factor != NULL) {
+		taucs_supernodal_factor_free(m_factor);
+		m_factor = NULL;
+	}
+	m_ldlt.clear();
+	m_predicted_factor_size = 0;
+
+	m_perm.clear();
+	m_invperm.clear();
+
+	m_pattern_colptr.clear();
+	m_pattern_rowind.clear();
+	m_analyzed = false;
+}
@@ -0,0 +1,454 @@
+#ifndef _TAUCS_FACTORIZATION_H_
+#define _TAUCS_FACTORIZATION_H_
+
+// The class TaucsFactorization holds the factorization of a TaucsMatrix, so
+// that "A*x=b" can be solved for many right hand sides (e.g., arriving over
+// time) with a single factorization. The static functions of TaucsSolver
+// factor the matrix on every call.
+//
+// The factorization has two phases:
+// - the analysis, which depends only on the sparsity pattern of the matrix:
+//   the fill-reducing ordering and, for the Cholesky and LDL^T
+//   factorizations, the symbolic factorization (elimination tree, supernodes,
+//   structure of L);
+// - the numeric factorization, which depends on the values.
+// factor() reuses the analysis of the previous matrix if the new one has the
+// same pattern, so refactoring matrices whose values change (e.g., in a
+// Newton loop) only pays for the numeric factorization.
+//
+// The Cholesky factor can also be updated in place for a low-rank change of
+// the matrix (see update()), e.g., when a few constraints are added or removed.
+//
+// A Cholesky factorization can be saved to a file (see save()) and loaded by
+// another process for the same matrix (see load()), which maps the file
+// instead of factoring the matrix again.
+//
+// Usage:
+//		TaucsFactorization F;
+//		if (F.factor(A, TaucsFactorization::SYMMETRIC)) {
+//			F.solve(b1, x1);
+//			F.solve(b2, x2);
+//			... change the values of A ...
+//			F.refactor();
+//			F.solve(b3, x3);
+//		}
+
+#include "sparse_lu.h"
+#include "sparse_ldlt.h"
+#include "normal_equations.h"
+#include "mapped_file.h"
+
+#include <vector>
+#include <string>
+#include <mutex>
+
+
+class TaucsMatrix;
+struct taucs_ccs_matrix;
+
+class TaucsFactorization
+{
+public:
+	enum Mode {
+		SYMMETRIC,		// A is symmetric positive definite: Cholesky (LL^T) factorization, in-core or 
+						// out-of-core (see set_memory_budget())
+		NON_SYMMETRIC,	// A is square: LU factorization, in-core or out-of-core
+		LEAST_SQUARES,	// A is m * n (m >= n): Cholesky factorization of A^T*A, in-core or out-of-core
+		SYMMETRIC_INDEFINITE	// A is symmetric (e.g., a KKT matrix): LDL^T factorization with
+								// static pivoting (see SparseLDLT and set_pivot_tolerance())
+	};
+
+	// The fill-reducing orderings (see set_ordering())
+	enum Ordering {
+		DEFAULT_ORDERING,	// metis (amd if TAUCS was built without metis), colamd for NON_SYMMETRIC
+		AUTO_ORDERING,		// the candidate with the smallest predicted factor (see select_ordering())
+		AMD,				// approximate minimum degree
+		MD,					// minimum degree
+		MMD,				// multiple minimum degree
+		GENMMD,				// multiple minimum degree (genmmd)
+		COLAMD,				// column approximate minimum degree (NON_SYMMETRIC only)
+		METIS,				// nested dissection
+		IDENTITY,			// no reordering
+		USER_ORDERING		// the permutation given to set_ordering()
+	};
+
+	// The prediction of an ordering evaluated by AUTO_ORDERING
+	struct OrderingCandidate {
+		Ordering	ordering;
+		double		nnz_L;		// the number of nonzeros of the Cholesky factor
+		double		flops;		// the number of operations of the factorization
+	};
+
+	// The number of calls to each phase and their total time (in seconds)
+	struct Statistics {
+		Statistics() : nb_analyses(0), nb_factorizations(0), nb_solves(0), nb_updates(0), analyze_time(0), factor_time(0), solve_time(0),
+			update_time(0), bytes_read(0), bytes_written(0), io_time(0) {}
+
+		int		nb_analyses;
+		int		nb_factorizations;
+		int		nb_solves;
+		int		nb_updates;			// the rank-1 updates and downdates done in place
+		double	analyze_time;		// ordering and symbolic factorization
+		double	factor_time;		// numeric factorization (including A^T*A for LEAST_SQUARES)
+		double	solve_time;
+		double	update_time;		// the updates done in place (the refactorizations are in factor_time)
+
+		// The disk I/O of the out-of-core LU and Cholesky factorizations (and
+		// of their solves)
+		double	bytes_read;
+		double	bytes_written;
+		double	io_time;
+	};
+
+public:
+	static std::string title() { return "[TaucsFactorization]: "; }
+
+	TaucsFactorization();
+
+	/// Release the factorization
+	~TaucsFactorization();
+
+	/// Compute the analysis of A (see Mode), without the numeric factorization.
+	/// A previous factorization is released first.
+	/// Return false if the dimensions of A do not fit mode or if the
+	/// analysis fails.
+	bool analyze(const TaucsMatrix& A, Mode mode);
+
+	/// Factor A (see Mode). The current analysis is reused if it was computed
+	/// for the same mode and the same sparsity pattern, otherwise A is analyzed
+	/// first. A must outlive the factorization if refactor() is used.
+	/// Return false if the dimensions of A do not fit mode or if the
+	/// factorization fails.
+	bool factor(const TaucsMatrix& A, Mode mode);
+
+	/// Factor again the matrix given to analyze() or factor(), e.g., after its
+	/// values changed. The dimensions of the matrix must not have changed.
+	bool refactor();
+
+	/// Release the factorization and the analysis (and the matrices they use).
+	void release();
+
+	/// Return true if an analysis is available for factor()
+	bool is_analyzed() const { return m_analyzed; }
+
+	/// Return true if a factorization is available for solve()
+	bool is_factored() const { return m_factored; }
+
+	Mode mode() const { return m_mode; }
+
+	/// Set the fill-reducing ordering used by the next analysis (default:
+	/// DEFAULT_ORDERING). For NON_SYMMETRIC, the orderings other than colamd
+	/// are computed on the pattern of A + A^T, and used as column orderings.
+	/// With AUTO_ORDERING, the analysis computes amd, mmd, genmmd and metis
+	/// (colamd, amd and metis for NON_SYMMETRIC), predicts the fill of each
+	/// of them (symbolically, for diagonal pivots in the LU case), and keeps
+	/// the one with the smallest factor, then the fewest operations.
+	void set_ordering(Ordering ordering);
+
+	/// Use the permutation perm as the ordering: row and column perm[k] of A
+	/// (column perm[k] for NON_SYMMETRIC) is eliminated at step k.
+	void set_ordering(const std::vector<int>& perm);
+
+	Ordering ordering() const { return m_ordering; }
+
+	/// Return the ordering used by the current analysis (AUTO_ORDERING and
+	/// DEFAULT_ORDERING are replaced by the actual ordering).
+	Ordering selected_ordering() const { return m_selected_ordering; }
+
+	/// Return the orderings evaluated by the last analysis with AUTO_ORDERING
+	const std::vector<OrderingCandidate>& ordering_candidates() const { return m_candidates; }
+
+	/// Return the TAUCS name of an ordering ("amd", "metis", ...)
+	static const char* ordering_name(Ordering ordering);
+
+	/// Set the memory (in bytes) that the LU factorization (NON_SYMMETRIC) and
+	/// the Cholesky factorization (SYMMETRIC and LEAST_SQUARES) may use: the
+	/// factorization is in-core if the factor fits, and out-of-core with this
+	/// amount of memory otherwise. The size of the factor is predicted by the
+	/// analysis (see predicted_factor_size()). The LU factorization predicted 
+	/// in-core switches to out-of-core, from scratch, if partial pivoting makes
+	/// the factor outgrow the budget.
+	/// The default (a negative value) is taucs_available_memory_size(), i.e.,
+	/// most of the memory of the machine: set a budget when several solves run
+	/// side by side.
+	void set_memory_budget(double bytes) { m_memory_budget = bytes; }
+	double memory_budget() const { return m_memory_budget; }
+
+	/// Always use the out-of-core LU and Cholesky factorizations (false by
+	/// default).
+	void set_force_out_of_core(bool force) { m_force_out_of_core = force; }
+
+	/// Return the size (in bytes) of the factor predicted by the analysis, from
+	/// its number of nonzeros: the Cholesky factor (SYMMETRIC and LEAST_SQUARES),
+	/// or the LU factor with diagonal pivots, i.e., twice the Cholesky factor of
+	/// P*(A+A^T)*P^T (NON_SYMMETRIC).
+	double predicted_factor_size() const { return m_predicted_factor_size; }
+
+	/// Set the directory of the files of the out-of-core factorizations, e.g.,
+	/// a local scratch disk (default: the current directory). Each factorization
+	/// uses its own files (named after the process id and a counter), so the
+	/// factorizations of one or several processes can share the directory.
+	/// The files are deleted with the factor.
+	void set_scratch_directory(const std::string& directory) { m_scratch_directory = directory; }
+	const std::string& scratch_directory() const { return m_scratch_directory; }
+
+	/// Set the number of threads of the solves with several vectors (default:
+	/// Parallel::default_num_threads()). The threads share the factor, each
+	/// one solving a range of the vectors. The out-of-core factorizations
+	/// always solve with a single thread.
+	void set_num_threads(int num_threads) { m_num_threads = num_threads; }
+	int num_threads() const { return m_num_threads; }
+
+	/// Return true if the factor is in-core (false if it is out-of-core or if
+	/// the matrix is not factored)
+	bool is_in_core() const { return m_factored && m_lu == NULL && m_ooc_llt == NULL; }
+
+	/// Set the threshold below which the pivots of the LDL^T factorization
+	/// (SYMMETRIC_INDEFINITE), relative to the largest element of A, are
+	/// perturbed (default: 1e-8). The solves then refine the solution.
+	void set_pivot_tolerance(double tolerance) { m_pivot_tolerance = tolerance; }
+	double pivot_tolerance() const { return m_pivot_tolerance; }
+
+	/// The number of perturbed and negative pivots of the LDL^T factorization
+	/// (SYMMETRIC_INDEFINITE). Without perturbed pivots, the number of negative
+	/// pivots is the number of negative eigenvalues of A (its inertia).
+	int nb_perturbed_pivots() const { return m_ldlt.nb_perturbed_pivots(); }
+	int nb_negative_pivots() const { return m_ldlt.nb_negative_pivots(); }
+
+	/// The largest backward error of the solutions of the last solve with the
+	/// LDL^T factorization, after the refinement (0 if no pivot was perturbed).
+	/// The solves fail if it exceeds SparseLDLT::MAX_BACKWARD_ERROR, i.e., if
+	/// the static pivoting did not converge (X holds the best iterates).
+	double backward_error() const { return m_backward_error; }
+
+	/// solve for "A*x=b" (in least square sense for LEAST_SQUARES) with the
+	/// current factorization.
+	/// b: the right side column vector, of size A.row_dimension()
+	/// x: the result, of size A.column_dimension()
+	bool solve(const std::vector<double>& b, std::vector<double>& x) const;
+
+	/// solve for "A*x=b" for an array of right side column vectors
+	/// B: the array of right side column vectors
+	/// X: the array of result vectors
+	bool solve(const std::vector< std::vector<double> >& B, std::vector< std::vector<double> >& X) const;
+
+	/// solve for "A*X=B" for nrhs right side column vectors stored by columns
+	/// (column-major): column c of B starts at B + c*ldb, and column c of X at
+	/// X + c*ldx (ldb >= A.row_dimension(), ldx >= A.column_dimension()).
+	/// The factor is traversed once for each block of RHS_BLOCK_SIZE vectors
+	/// (except by the out-of-core factorizations, which solve them one by
+	/// one), by num_threads() threads. X and B can be the same array for
+	/// square matrices.
+	/// Note: the first solve with several vectors keeps a compressed column
+	///       copy of the Cholesky factor until the next factorization.
+	bool solve(int nrhs, const double* B, int ldb, double* X, int ldx) const;
+
+	enum { RHS_BLOCK_SIZE = 32 };
+
+	/// Update the Cholesky factor (SYMMETRIC and LEAST_SQUARES) of the matrix
+	/// M, i.e., A or A^T*A, to the factor of M + W*W^T, where W is n x k (not
+	/// symmetric): e.g., the rows of k soft constraints added to A for
+	/// LEAST_SQUARES, or k rank-1 terms added to A. Each column w of W updates
+	/// the columns of the factor on the path of the elimination tree from the
+	/// first row of w, in time proportional to their number of nonzeros.
+	/// The factorization of M + W*W^T (and of the previous updates) is computed
+	/// instead, analyzed again if its pattern changed, if the rows of a column
+	/// w of W are not all in the pattern of the column of the factor at the
+	/// first row of w (the update would create fill), if the updates would cost
+	/// more operations than the factorization, or if the factor is out-of-core.
+	/// Notes: factor() and refactor() discard the updates (they factor A).
+	///        For LEAST_SQUARES, solve() computes the right side A^T*b with A
+	///        only: use solve_normal_equations() to include the rows of W.
+	/// Return false if the mode is not SYMMETRIC or LEAST_SQUARES, or if W
+	/// does not have n rows.
+	bool update(const TaucsMatrix& W);
+
+	/// Downdate the Cholesky factor of M to the factor of M - W*W^T (see
+	/// update()), e.g., when soft constraints are removed.
+	/// Return false (and the factorization is lost) if M - W*W^T is not
+	/// positive definite.
+	bool downdate(const TaucsMatrix& W);
+
+	/// solve for "M*x=rhs" with the (updated) Cholesky factor of M, i.e., A or
+	/// A^T*A for LEAST_SQUARES (SYMMETRIC and LEAST_SQUARES only).
+	/// rhs and x have A.column_dimension() elements.
+	bool solve_normal_equations(const std::vector<double>& rhs, std::vector<double>& x) const;
+
+	/// Save the Cholesky factorization (SYMMETRIC and LEAST_SQUARES) to a
+	/// binary file: the mode, the dimensions, the ordering, the compressed
+	/// column factor and the fingerprint of A (see TaucsUtil::Fingerprint())
+	/// recorded by the factorization, even if A changed since. The file is
+	/// written under a temporary name and then renamed, so that a process
+	/// never loads a partial file.
+	/// Return false if the factor is out-of-core or updated, or if the file
+	/// can not be written.
+	bool save(const std::string& file_name) const;
+
+	/// Load the factorization of A saved by save(), instead of factoring A
+	/// (e.g., when a process starts). The file is mapped read-only (see
+	/// MappedFile): its pages are read on demand by the solves and shared by
+	/// the processes that load it. For LEAST_SQUARES, only A is kept (for the
+	/// right sides A^T*b): A^T*A is computed if an update() refactors it.
+	/// The previous factorization is released first.
+	/// Return false if the file is not a factorization of this version (or of
+	/// this byte order), or if it was saved for another matrix, i.e., its
+	/// fingerprint differs from the one of A: a stale file must be saved again.
+	bool load(const std::string& file_name, const TaucsMatrix& A);
+
+	/// Return true if the factor is the one mapped by load()
+	bool is_loaded() const { return m_mapped_factor.is_open(); }
+
+	/// The statistics since the construction or the last reset_statistics()
+	const Statistics& statistics() const { return m_statistics; }
+	void reset_statistics() { m_statistics = Statistics(); }
+
+private:
+	// Not copyable (the factor cannot be shared)
+	TaucsFactorization(const TaucsFactorization&);
+	TaucsFactorization& operator=(const TaucsFactorization&);
+
+	// Return true if the dimensions of A fit mode
+	bool check_dimensions(const TaucsMatrix& A, Mode mode) const;
+
+	// Return the matrix to factor for A in m_mode: the TAUCS matrix of A, or
+	// A^T*A for LEAST_SQUARES (recomputed by m_normal_equations).
+	const taucs_ccs_matrix* matrix_to_factor(const TaucsMatrix& A);
+
+	// Compute the ordering of M, and its inverse. Return false if it fails.
+	bool compute_ordering(const taucs_ccs_matrix* M, Ordering ordering, std::vector<int>& perm, std::vector<int>& invperm) const;
+
+	// Select the ordering of M with the smallest predicted factor (and set 
+	// m_perm, m_invperm and m_candidates). Return DEFAULT_ORDERING if no
+	// candidate could be computed.
+	Ordering select_ordering(const taucs_ccs_matrix* M);
+
+	// Return true if M has the sparsity pattern of the current analysis
+	bool same_pattern(const taucs_ccs_matrix* M) const;
+
+	// The two phases on the matrix to factor M
+	bool analyze_matrix(const taucs_ccs_matrix* M);
+	bool factor_matrix(const taucs_ccs_matrix* M);
+
+	// Solve for nrhs vectors with the compressed column Cholesky factor L, by
+	// blocks of RHS_BLOCK_SIZE vectors. For LEAST_SQUARES, the vectors are
+	// multiplied by A^T first, unless normal_equations is true.
+	void solve_llt(const taucs_ccs_matrix* L, int nrhs, const double* B, int ldb, double* X, int ldx, 
+		bool normal_equations = false) const;
+
+	// Solve M*x = b with the Cholesky factor of M (A or A^T*A)
+	bool solve_cholesky(const double* b, double* x) const;
+
+	// Update (sigma = 1) or downdate (sigma = -1) the factor with the columns of W
+	bool update(const TaucsMatrix& W, double sigma);
+
+	// The rank-1 update of the compressed column factor with column c of W,
+	// whose rows are in the pattern of column first of the factor.
+	// Return false if the downdated matrix is not positive definite.
+	bool update_column(const taucs_ccs_matrix* W, int c, int first, double sigma);
+
+	// Factor the matrix of the last factorization plus the updates since
+	bool factor_updated_matrix();
+
+	// Discard the updates (and the updated matrix)
+	void clear_updates();
+
+	// Return the compressed column copy of the Cholesky factor, in which the
+	// diagonal comes first in each column (created by the first call)
+	const taucs_ccs_matrix* factor_ccs() const;
+
+	// Return the memory budget, or the available memory by default
+	double available_memory() const;
+
+	// Return a new name for the files of the out-of-core factorizations
+	std::string scratch_file_name() const;
+
+	// Free the numeric factorization (the analysis is kept)
+	void free_numeric();
+
+	// Free the numeric factorization and the analysis
+	void free_analysis();
+
+private:
+	const TaucsMatrix*	m_matrix;
+	Mode				m_mode;
+	int					m_rows;
+	int					m_columns;
+
+	// The ordering requested by set_ordering()
+	Ordering			m_ordering;
+	std::vector<int>	m_user_perm;
+	bool				m_ordering_changed;
+
+	// The analysis: the fill-reducing ordering and the pattern it was computed for
+	Ordering			m_selected_ordering;
+	std::vector<OrderingCandidate>	m_candidates;
+	std::vector<int>	m_perm;
+	std::vector<int>	m_invperm;
+	std::vector<int>	m_pattern_colptr;
+	std::vector<int>	m_pattern_rowind;
+	bool				m_analyzed;
+
+	// The supernodal Cholesky factor of the permuted matrix (SYMMETRIC and
+	// LEAST_SQUARES): the symbolic factorization, plus the numeric one if
+	// m_factored is true. NULL if the factor is out-of-core.
+	void*				m_factor;
+
+	// The out-of-core Cholesky factor: the taucs_io_handle of its multifile,
+	// if the predicted size of the factor exceeds the memory budget
+	void*				m_ooc_llt;
+	double				m_predicted_factor_size;
+
+	// Its compressed column copy for the solves with several vectors
+	mutable taucs_ccs_matrix*	m_factor_ccs;
+	mutable std::mutex			m_factor_ccs_mutex;
+
+	// The fingerprint of A when the in-core Cholesky factor was computed (or
+	// loaded), for save()
+	unsigned long long	m_fingerprint;
+
+	// The file mapped by load(): the arrays of m_factor_ccs point into it
+	MappedFile			m_mapped_factor;
+
+	// The LDL^T factor (SYMMETRIC_INDEFINITE): its analysis, plus the numeric
+	// factorization if m_factored is true
+	SparseLDLT			m_ldlt;
+	double				m_pivot_tolerance;
+	mutable double		m_backward_error;
+
+	// The LU factor (NON_SYMMETRIC): in-core, or the taucs_io_handle of its
+	// multifile
+	SparseLU			m_in_core_lu;
+	void*				m_lu;
+	double				m_memory_budget;
+	bool				m_force_out_of_core;
+	std::string			m_scratch_directory;
+
+	int					m_num_threads;
+
+	// The updates: the elimination tree of the factor, the number of
+	// operations of its factorization, and work arrays
+	std::vector<int>	m_factor_parent;
+	double				m_factorization_cost;
+	std::vector<double>	m_update_values;
+	std::vector<int>	m_update_mark;
+	int					m_update_stamp;
+	// m_factor_ccs is updated (and m_factor is not)
+	bool				m_updated;
+	// the columns of W (and their signs) applied since the last factorization
+	// of the matrix, which is A (or A^T*A), or m_updated_matrix if not NULL
+	std::vector<int>	m_updates_colptr;
+	std::vector<int>	m_updates_rowind;
+	std::vector<double>	m_updates_values;
+	std::vector<double>	m_updates_sigma;
+	taucs_ccs_matrix*	m_updated_matrix;
+
+	bool				m_factored;
+
+	// A^T*A (LEAST_SQUARES)
+	NormalEquations		m_normal_equations;
+
+	mutable Statistics	m_statistics;
+};
+
+
+#endif // _TAUCS_FACTORIZATION_H_
@@ -1,4 +1,9 @@
 #include "taucs_matrix.h"
+#include "taucs_util.h"
+
+#include <cstring>
+#include <iostream>
+#include <limits>
 
 // Taucs is a C library
 extern "C" {
@@ -10,6 +15,9 @@ extern "C" {
 	TaucsMatrix::TaucsMatrix(int dim, bool is_symmetric /* = false*/)	
 		: SparseMatrix(dim, is_symmetric)
 		, m_matrix(0)
+		, m_owns_arrays(true)
+		, m_matrix_pattern_version(0)
+		, m_matrix_values_version(0)
 	{
 	}
 
@@ -17,44 +25,105 @@ extern "C" {
 	TaucsMatrix::TaucsMatrix(int rows, int columns, bool is_symmetric /* = false*/)		
 		: SparseMatrix(rows, columns, is_symmetric)
 		, m_matrix(0)
+		, m_owns_arrays(true)
+		, m_matrix_pattern_version(0)
+		, m_matrix_values_version(0)
 	{
 	}
 
 
+	/// Create a matrix over existing compressed column arrays, without any copy.
+	TaucsMatrix::TaucsMatrix(int rows, int columns, int* colptr, int* rowind, double* values, bool is_symmetric /* = false*/)
+		: SparseMatrix(rows, columns, is_symmetric)
+		, m_matrix(0)
+		, m_owns_arrays(false)
+		, m_matrix_pattern_version(0)
+		, m_matrix_values_version(0)
+	{
+		// A TAUCS matrix pointing to the caller's arrays
+		m_matrix = new taucs_ccs_matrix;
+		memset(m_matrix, 0, sizeof(taucs_ccs_matrix));
+		m_matrix->m = rows;
+		m_matrix->n = columns;
+		m_matrix->flags = taucs_flags();
+		m_matrix->colptr = colptr;
+		m_matrix->rowind = rowind;
+		m_matrix->values.v = values;
+
+		SparseMatrix::attach_pattern(colptr, rowind, values);
+	}
+
 	/// Delete this object and the wrapped TAUCS matrix.
 	TaucsMatrix::~TaucsMatrix()
 	{
 		// Delete the the wrapped TAUCS matrix
+		free_taucs_matrix();
+	}
+
+	void TaucsMatrix::free_taucs_matrix() const
+	{
 		if (m_matrix != NULL) {
-			taucs_ccs_free(m_matrix);
+			if (m_owns_arrays)
+				taucs_ccs_free(m_matrix);
+			else
+				delete m_matrix;	// the arrays belong to the caller
 			m_matrix = NULL;
 		}
+		m_owns_arrays = true;
 	}
 
 	/// Construct and return the TAUCS matrix wrapped by this object.
+	/// The TAUCS matrix is cached: it is rebuilt only if new elements were 
+	/// inserted since the previous call, and its values are refreshed in place
+	/// if only the values of existing elements changed.
 	/// Note: the TAUCS matrix returned by this method is valid
 	///       only until the next call to set_coef(), add_coef() or get_taucs_matrix().
+	/// Return NULL if the matrix has more nonzeros than TAUCS can index (2^31-1).
 	const taucs_ccs_matrix* TaucsMatrix::get_taucs_matrix() const
 	{
+		// The elements are stored in m_matrix
+		if (has_compressed_arrays())
+			return m_matrix;
+
 		if (m_matrix != NULL) {
-			taucs_ccs_free(m_matrix);
-			m_matrix = NULL;
-		}
+			// Same pattern: reuse the cached matrix
+			if (m_matrix_pattern_version == m_pattern_version) {
+				if (m_matrix_values_version != m_values_version) {
+					double* taucs_values = (double*) m_matrix->values.v;
+					for (int col=0; col < m_column_dimension; col++) {
+						int nb_elements = m_columns[col].dimension();
+						if (nb_elements > 0)
+							memcpy(&taucs_values[m_matrix->colptr[col]], m_pool.values(m_columns[col]), nb_elements*sizeof(double));
+					}
+					m_matrix_values_version = m_values_version;
+				}
+				return m_matrix;
+			}
 
-		// Convert matrix's double type to the corresponding TAUCS constant
-		int flags = TAUCS_DOUBLE;
+			free_taucs_matrix();
+		}
 
-		// We store only the lower triangle of symmetric matrices
-		if (m_is_symmetric)
-			flags |= TAUCS_TRIANGULAR | TAUCS_SYMMETRIC | TAUCS_LOWER;
+		int flags = taucs_flags();
 
 		// Compute the number of non null elements in the matrix
-		int nb_max_elements = 0;
+		SparseOffset nb_max_elements = 0;
 		for (int col=0; col < m_column_dimension; col++)
 			nb_max_elements += m_columns[col].dimension();
 
+		// TAUCS indexes the elements with int
+		if (nb_max_elements > std::numeric_limits<int>::max()) {
+			std::cout << "[TaucsMatrix]: " << nb_max_elements << " nonzeros, TAUCS supports at most " 
+				<< std::numeric_limits<int>::max() << std::endl;
+			return NULL;
+		}
+
+		// The columns are then stored like m_matrix's rowind[] and values[] arrays
+		compact();
+
 		// Create the TAUCS matrix wrapped by this object
-		m_matrix = taucs_ccs_create(m_row_dimension, m_column_dimension, nb_max_elements, flags);
+		m_matrix = taucs_ccs_create(m_row_dimension, m_column_dimension, static_cast<int>(nb_max_elements), flags);
+		if (m_matrix == NULL)
+			return NULL;
 
 		// Fill m_matrix's colptr[], rowind[] and values[] arrays
 		// Implementation note:
@@ -62,20 +131,129 @@ extern "C" {
 		// - values[] = array of row index of each element of rowind[]
 		// - colptr[j] is the index of the first element of the column j (or where it
 		//   should be if it doesn't exist) + the past-the-end index of the last column
-		m_matrix->colptr[0] = 0;
-		for (int col=0; col < m_column_dimension; col++)
-		{
-			// Number of non null elements of the column
-			int nb_elements = m_columns[col].dimension();
-
-			// Fast copy of column indices and values
-			memcpy(&m_matrix->rowind[m_matrix->colptr[col]], &m_columns[col].m_indices[0], nb_elements*sizeof(int));
-			double* taucs_values = (double*) m_matrix->values.v;
-			memcpy(&taucs_values[m_matrix->colptr[col]], &m_columns[col].m_values[0],  nb_elements*sizeof(double));
+		int begin = 0;
+		for (int col=0; col < m_column_dimension; col++) {
+			m_matrix->colptr[col] = begin;
+			begin += m_columns[col].dimension();
+		}
+		m_matrix->colptr[m_column_dimension] = begin;
 
-			// Start of next column will be:
-			m_matrix->colptr[col+1] = m_matrix->colptr[col] + nb_elements;
+		// Fast copy of the indices and values of all columns (compact() stored
+		// them contiguously, in column order, from the beginning of the pool)
+		if (nb_max_elements > 0) {
+			memcpy(m_matrix->rowind, m_pool.indices(m_columns[0]), nb_max_elements*sizeof(int));
+			memcpy(m_matrix->values.v, m_pool.values(m_columns[0]), nb_max_elements*sizeof(double));
 		}
 
+		m_matrix_pattern_version = m_pattern_version;
+		m_matrix_values_version  = m_values_version;
+
 		return m_matrix;
 	}
+
+
+	/// Return the number of bytes used to store the matrix, including the
+	/// cached TAUCS matrix (which holds the elements if the pattern is frozen).
+	std::size_t TaucsMatrix::memory_usage() const
+	{
+		std::size_t size = SparseMatrix::memory_usage();
+		if (m_matrix != NULL && m_owns_arrays) {
+			int nnz = m_matrix->colptr[m_matrix->n];
+			size += (m_matrix->n + 1) * sizeof(int) + nnz * (sizeof(int) + sizeof(double));
+		}
+		return size;
+	}
+
+
+	bool TaucsMatrix::set_triplets(int nb_triplets, const int* rows, const int* cols, const double* values)
+	{
+		if (is_pattern_frozen())
+			return false;
+
+		taucs_ccs_matrix* mat = TaucsUtil::CreateTaucsMatrixFromTriplets(
+			m_row_dimension, m_column_dimension, nb_triplets, rows, cols, values, taucs_flags());
+		if (mat == NULL)
+			return false;
+
+		// mat is exactly what get_taucs_matrix() would build: it becomes the 
+		// only storage of the elements, which are copied into the columns only
+		// if an element outside its pattern is inserted later
+		SparseMatrix::release_elements();
+		free_taucs_matrix();
+		m_matrix = mat;
+		SparseMatrix::attach_elements(mat->colptr, mat->rowind, (double*) mat->values.v);
+		m_matrix_pattern_version = m_pattern_version;
+		m_matrix_values_version  = m_values_version;
+
+		return true;
+	}
+
+
+	void TaucsMatrix::freeze_pattern()
+	{
+		if (is_pattern_frozen())
+			return;
+
+		// The elements given to set_triplets() are already stored in m_matrix
+		if (has_compressed_arrays()) {
+			m_lazy_columns = false;
+			return;
+		}
+
+		// Make sure m_matrix is sized for the current pattern, then move the 
+		// elements into its arrays
+		if (get_taucs_matrix() == NULL)
+			return;
+		SparseMatrix::freeze_pattern(m_matrix->colptr, m_matrix->rowind, (double*) m_matrix->values.v);
+	}
+
+
+	void TaucsMatrix::unfreeze_pattern()
+	{
+		if (!is_pattern_frozen())
+			return;
+
+		SparseMatrix::unfreeze_pattern();
+
+		// Stop using the caller's arrays
+		if (!m_owns_arrays) {
+			free_taucs_matrix();
+			return;
+		}
+
+		// m_matrix is still a valid copy of the columns
+		m_matrix_pattern_version = m_pattern_version;
+		m_matrix_values_version  = m_values_version;
+	}
+
+
+	taucs_ccs_matrix* TaucsMatrix::release_taucs_matrix()
+	{
+		taucs_ccs_matrix* mat = NULL;
+		if (m_owns_arrays) {
+			if (get_taucs_matrix() == NULL)		// no copy if m_matrix is up to date
+				return NULL;
+			mat = m_matrix;
+			m_matrix = NULL;
+		}
+		else {
+			mat = TaucsUtil::MatrixCopy(m_matrix);
+			free_taucs_matrix();
+		}
+
+		SparseMatrix::release_elements();
+		return mat;
+	}
+
+
+	int TaucsMatrix::taucs_flags() const
+	{
+		// Convert matrix's double type to the corresponding TAUCS constant
+		int flags = TAUCS_DOUBLE;
+
+		// We store only the lower triangle of symmetric matrices
+		if (m_is_symmetric)
+			flags |= TAUCS_TRIANGULAR | TAUCS_SYMMETRIC | TAUCS_LOWER;
+
+		return flags;
+	}
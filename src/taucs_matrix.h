@@ -19,19 +19,87 @@ public:
 	/// Create a rectangular matrix initialized with zeros.
 	TaucsMatrix(int rows, int columns, bool is_symmetric = false);
 
+	/// Create a rows x columns matrix over existing compressed column arrays,
+	/// without any copy: colptr[columns+1], rowind[nnz] (sorted in each column)
+	/// and values[nnz], as in taucs_ccs_matrix. The arrays remain owned by the 
+	/// caller and must outlive this object. For symmetric matrices, they must 
+	/// hold the lower triangle only.
+	/// The pattern of the matrix is frozen (see freeze_pattern()): set_coef(), 
+	/// add_coef(), ... write directly into values[], and get_taucs_matrix() 
+	/// returns a TAUCS matrix pointing to the arrays. unfreeze_pattern() copies
+	/// the elements, after which the arrays are not used anymore.
+	TaucsMatrix(int rows, int columns, int* colptr, int* rowind, double* values, bool is_symmetric = false);
+
 	/// Delete this object and the wrapped TAUCS matrix.
 	~TaucsMatrix();
 
 	/// Construct and return the TAUCS matrix wrapped by this object.
+	/// The TAUCS matrix is cached: it is rebuilt only if new elements were 
+	/// inserted since the previous call, and its values are refreshed in place
+	/// if only the values of existing elements changed.
 	/// Note: the TAUCS matrix returned by this method is valid
 	///       only until the next call to set_coef(), add_coef() or get_taucs_matrix().
+	/// Return NULL if the matrix has more nonzeros than TAUCS can index (2^31-1).
 	const taucs_ccs_matrix* get_taucs_matrix() const;
 
+	/// Replace the content of the matrix by nb_triplets (rows[k], cols[k], values[k])
+	/// triplets given in any order. Duplicated entries are summed; for symmetric
+	/// matrices, the triplets in the upper triangle are ignored (like add_coef()).
+	/// The triplets are sorted in bulk (see TaucsUtil::CreateTaucsMatrixFromTriplets), 
+	/// which is much faster than calling add_coef() for each of them.
+	/// The resulting TAUCS matrix is the only copy of the elements: they are 
+	/// copied into modifiable columns only if set_coef() or add_coef() inserts
+	/// an element outside its pattern later.
+	/// Return false if an index is out of range or if the pattern is frozen
+	/// (the matrix is then left unchanged).
+	bool set_triplets(int nb_triplets, const int* rows, const int* cols, const double* values);
+
+	/// Freeze the sparsity pattern, e.g., after the first assembly in a Newton or
+	/// time-stepping loop where only the values change. From now on, the elements
+	/// are stored directly in the TAUCS matrix: set_coef(), add_coef(), set_coef_at(),
+	/// add_coef_at() and update_values() write into its values array, and 
+	/// get_taucs_matrix() always returns the same matrix without any copy.
+	/// Use get_slot() to precompute the slots of the elements once, and 
+	/// set_coef_at()/add_coef_at() to scatter the values.
+	/// Note: only elements of the pattern can be written while it is frozen
+	/// (set_coef() and add_coef() return false for the others).
+	/// The pattern is not frozen if get_taucs_matrix() fails.
+	void freeze_pattern();
+
+	/// Go back to a modifiable sparsity pattern.
+	void unfreeze_pattern();
+
+	/// Give the TAUCS matrix to the caller, who must free it with taucs_ccs_free().
+	/// The elements are not copied if the pattern is frozen or if the TAUCS 
+	/// matrix is up to date (e.g., right after get_taucs_matrix() or set_triplets()).
+	/// If the matrix was created over the caller's arrays, a copy is returned.
+	/// This matrix is then empty (all coefficients are zero, the pattern is 
+	/// not frozen). Return NULL (and keep the matrix) if get_taucs_matrix() fails.
+	taucs_ccs_matrix* release_taucs_matrix();
+
+	/// Return the number of bytes used to store the matrix, including the
+	/// cached TAUCS matrix.
+	virtual std::size_t memory_usage() const;
+
+private:
+	/// The TAUCS flags corresponding to this matrix
+	int taucs_flags() const;
+
+	/// Delete m_matrix (only the taucs_ccs_matrix struct if m_owns_arrays is false)
+	void free_taucs_matrix() const;
+
 private:
 	/// The actual TAUCS matrix wrapped by this object.
 	// This is in fact a COPY of the columns array
 	mutable taucs_ccs_matrix* m_matrix;
 
+	// False if m_matrix points to arrays owned by the caller
+	mutable bool m_owns_arrays;
+
+	// The versions of the columns array that m_matrix is a copy of
+	mutable unsigned long long m_matrix_pattern_version;
+	mutable unsigned long long m_matrix_values_version;
+
 }; // TaucsMatrix
 
 
@@ -1,7 +1,12 @@
 #include "taucs_solver.h"
 #include "taucs_matrix.h"
 #include "taucs_util.h"
+#include "taucs_factorization.h"
+#include "normal_equations.h"
 #include <iostream>
+#include <algorithm>
+#include <limits>
+#include <cmath>
 
 
 #define  TAUCS_CORE_DOUBLE
@@ -29,39 +34,15 @@ bool TaucsSolver::solve_symmetry(const TaucsMatrix& matrix,
 
 	//////////////////////////////////////////////////////////////////////////
 
-	// A
-	taucs_ccs_matrix* A = (taucs_ccs_matrix*)matrix.get_taucs_matrix();
-
-	// X
-	result.resize(num_col);
-
-	//////////////////////////////////////////////////////////////////////////
-
-	// solve
-	void* F = NULL;
-	char* factor[] = {"taucs.factor.LLT=true", NULL};
-	char* solve[]  = {"taucs.factor=false", NULL};
-	void* opt_arg[] = { NULL };
-
-	/* this should work, factor, solve, free */
-	int slove_rc = taucs_linsolve(A, &F, 1, &(result[0]), (void*)&(rhs[0]), factor, opt_arg);
-	if (slove_rc != TAUCS_SUCCESS)
-		std::cout << title() << "solve failed!" << std::endl;
-
-	int free_rc = taucs_linsolve(NULL, &F, 0, NULL, NULL, factor, opt_arg);
-	if (free_rc != TAUCS_SUCCESS)
-		std::cout << title() << "free failed!" << std::endl;
-
-	// clean
-	//taucs_ccs_free(A); // A will be free by TaucsMatrix
-
-	return (slove_rc == TAUCS_SUCCESS) && (free_rc == TAUCS_SUCCESS);
+	// factor, solve, free
+	TaucsFactorization F;
+	return F.factor(matrix, TaucsFactorization::SYMMETRIC) && F.solve(rhs, result);
 }
 
 
-bool TaucsSolver::solve_non_symmetry(const TaucsMatrix& matrix, 
-								   const std::vector<double>& rhs, 
-								   std::vector<double>& result)
+bool TaucsSolver::solve_symmetry_indefinite(const TaucsMatrix& matrix, 
+											const std::vector<double>& rhs, 
+											std::vector<double>& result)
 {
 	int num_row = matrix.row_dimension();
 	int num_col = matrix.column_dimension();
@@ -78,56 +59,34 @@ bool TaucsSolver::solve_non_symmetry(const TaucsMatrix& matrix,
 
 	//////////////////////////////////////////////////////////////////////////
 
-	// A
-	taucs_ccs_matrix* A = (taucs_ccs_matrix*)matrix.get_taucs_matrix();
-
-	// X
-	result.resize(num_col);
-
-	//////////////////////////////////////////////////////////////////////////
+	// factor, solve, free
+	TaucsFactorization F;
+	return F.factor(matrix, TaucsFactorization::SYMMETRIC_INDEFINITE) && F.solve(rhs, result);
+}
 
-	int*    perm = NULL;
-	int*    invperm = NULL;
 
-	// ordering
-	taucs_ccs_order(A, &perm, &invperm,	"colamd");
-	if ( perm == NULL || invperm == NULL) {
-		std::cout << title() << "ordering failed" << std::endl;
-		return false;
-	}
-
-	taucs_io_handle* LU = taucs_io_create_multifile("taucs.L");
-	if (LU == NULL) {
-		std::cout << title() << "can not create multifile" << std::endl;
-		return false;
-	}
-
-	// factorization
-	int memory_mb = int(taucs_available_memory_size() / 1048576.0);
-	int rc = taucs_ooc_factor_lu(A, perm, LU, memory_mb * 1048576.0);
-	if (rc != TAUCS_SUCCESS) {
-		std::cout << title() << "factorization failed" << std::endl;
-		return false;
-	}
+bool TaucsSolver::solve_non_symmetry(const TaucsMatrix& matrix, 
+								   const std::vector<double>& rhs, 
+								   std::vector<double>& result)
+{
+	int num_row = matrix.row_dimension();
+	int num_col = matrix.column_dimension();
 
-	// solve
-	rc = taucs_ooc_solve_lu(LU, &(result[0]), (void*)&(rhs[0]));
-	if (rc != TAUCS_SUCCESS) {
-		std::cout << title() << "solving failed" << std::endl;
+	if (num_row != num_col) {
+		std::cout << title() << "num_row != num_col" << std::endl;
 		return false;
 	}
-
-	// delete the temporal multifile
-	rc = taucs_io_delete(LU);
-	if (rc != TAUCS_SUCCESS) {
-		std::cout << title() << "delete multifile file failed" << std::endl;
+	
+	if (num_row != rhs.size()) {
+		std::cout << title() << "num_row != rhs.size()" << std::endl;
 		return false;
 	}
 
-	// clean
-	//taucs_ccs_free(A); // A will be free by TaucsMatrix
+	//////////////////////////////////////////////////////////////////////////
 
-	return (rc == TAUCS_SUCCESS);
+	// factor, solve, free
+	TaucsFactorization F;
+	return F.factor(matrix, TaucsFactorization::NON_SYMMETRIC) && F.solve(rhs, result);
 }
 
 
@@ -150,48 +109,72 @@ bool TaucsSolver::solve_linear_least_square(const TaucsMatrix& matrix,
 
 	//////////////////////////////////////////////////////////////////////////
 
-	// A
-	taucs_ccs_matrix* A = (taucs_ccs_matrix*)matrix.get_taucs_matrix();
-	taucs_ccs_matrix* At = TaucsUtil::MatrixTranspose(A);
-	taucs_ccs_matrix* AtA = TaucsUtil::Mul2NonSymmMatSymmResult(At, A);
+	// factor, solve, free
+	TaucsFactorization F;
+	return F.factor(matrix, TaucsFactorization::LEAST_SQUARES) && F.solve(rhs, result);
+}
 
-	std::vector<double> AtB(num_col);
-	TaucsUtil::MulNonSymmMatrixVector(At, &(rhs[0]), &(AtB[0]));
 
-	// X
-	result.resize(num_col);
+//////////////////////////////////////////////////////////////////////////
+// api for array rhs
+
+bool TaucsSolver::solve_symmetry(const TaucsMatrix& matrix, 
+								 const std::vector<std::vector<double>>& rhs, 
+								 std::vector<std::vector<double>>& result)
+{
+	int num_row = matrix.row_dimension();
+	int num_col = matrix.column_dimension();
+
+	if (num_row != num_col) {
+		std::cout << title() << "num_row != num_col" << std::endl;
+		return false;
+	}
+
+	for (unsigned int i=0; i<rhs.size(); ++i) {
+		if (num_row != rhs[i].size()) {
+			std::cout << title() << "num_row != rhs.size()" << std::endl;
+			return false;
+		}	
+	}
 
 	//////////////////////////////////////////////////////////////////////////
+	// first factor, then solve, then free 
 
-	// solve
-	void* F = NULL;
-	char* factor[] = {"taucs.factor.LLT=true", NULL};
-	char* solve[]  = {"taucs.factor=false", NULL};
-	void* opt_arg[] = { NULL };
+	TaucsFactorization F;
+	return F.factor(matrix, TaucsFactorization::SYMMETRIC) && F.solve(rhs, result);
+}
 
-	int slove_rc = taucs_linsolve(AtA, &F, 1, &(result[0]), &(AtB[0]), factor, opt_arg);
-	if (slove_rc != TAUCS_SUCCESS)
-		std::cout << title() << "solve failed" << std::endl;
 
-	int free_rc = taucs_linsolve(NULL, &F, 0, NULL, NULL, factor, opt_arg);
-	if (free_rc != TAUCS_SUCCESS) 
-		std::cout << title() << "free failed" << std::endl;
+bool TaucsSolver::solve_symmetry_indefinite(const TaucsMatrix& matrix, 
+											const std::vector<std::vector<double>>& rhs, 
+											std::vector<std::vector<double>>& result)
+{
+	int num_row = matrix.row_dimension();
+	int num_col = matrix.column_dimension();
 
-	// clean
-	//taucs_ccs_free(A); // A will be free by TaucsMatrix
-	taucs_ccs_free(At);
-	taucs_ccs_free(AtA);
+	if (num_row != num_col) {
+		std::cout << title() << "num_row != num_col" << std::endl;
+		return false;
+	}
 
-	return (slove_rc == TAUCS_SUCCESS) && (free_rc == TAUCS_SUCCESS);
-}
+	for (unsigned int i=0; i<rhs.size(); ++i) {
+		if (num_row != rhs[i].size()) {
+			std::cout << title() << "num_row != rhs.size()" << std::endl;
+			return false;
+		}	
+	}
 
+	//////////////////////////////////////////////////////////////////////////
+	// first factor, then solve, then free 
 
-//////////////////////////////////////////////////////////////////////////
-// api for array rhs
+	TaucsFactorization F;
+	return F.factor(matrix, TaucsFactorization::SYMMETRIC_INDEFINITE) && F.solve(rhs, result);
+}
 
-bool TaucsSolver::solve_symmetry(const TaucsMatrix& matrix, 
-								 const std::vector<std::vector<double>>& rhs, 
-								 std::vector<std::vector<double>>& result)
+
+bool TaucsSolver::solve_non_symmetry(const TaucsMatrix& matrix, 
+								   const std::vector<std::vector<double>>& rhs, 
+								   std::vector<std::vector<double>>& result)
 {
 	int num_row = matrix.row_dimension();
 	int num_col = matrix.column_dimension();
@@ -209,52 +192,168 @@ bool TaucsSolver::solve_symmetry(const TaucsMatrix& matrix,
 	}
 
 	//////////////////////////////////////////////////////////////////////////
+	// first factor, then solve, then free 
 
-	// A
-	taucs_ccs_matrix* A = (taucs_ccs_matrix*)matrix.get_taucs_matrix();
+	TaucsFactorization F;
+	return F.factor(matrix, TaucsFactorization::NON_SYMMETRIC) && F.solve(rhs, result);
+}
 
-	// X
-	result.resize(rhs.size());
-	for (unsigned int i=0; i<result.size(); ++i)
-		result[i].resize(num_col);
+
+bool TaucsSolver::solve_linear_least_square(const TaucsMatrix& matrix, 
+											const std::vector<std::vector<double>>& rhs, 
+											std::vector<std::vector<double>>& result)
+{
+	int num_row = matrix.row_dimension();
+	int num_col = matrix.column_dimension();
+
+	if (num_row < num_col) {
+		std::cout << title() << "num_row < num_col" << std::endl;
+		return false;
+	}
+
+	for (unsigned int i=0; i<rhs.size(); ++i) {
+		if (num_row != rhs[i].size()) {
+			std::cout << title() << "num_row != rhs.size()" << std::endl;
+			return false;
+		}	
+	}
 
 	//////////////////////////////////////////////////////////////////////////
 	// first factor, then solve, then free 
 
+	TaucsFactorization F;
+	return F.factor(matrix, TaucsFactorization::LEAST_SQUARES) && F.solve(rhs, result);
+}
+
+//////////////////////////////////////////////////////////////////////////
+// mixed precision api
+
+// The infinity norm of a double precision matrix (symmetric matrices store 
+// their lower triangle).
+static double infinity_norm(const taucs_ccs_matrix* A)
+{
+	bool symmetric = (A->flags & TAUCS_SYMMETRIC) != 0;
+	std::vector<double> row_sums(A->m, 0.0);
+	for (int col = 0; col < A->n; ++col) {
+		for (int p = A->colptr[col]; p < A->colptr[col+1]; ++p) {
+			double a = std::fabs(A->taucs_values[p]);
+			row_sums[A->rowind[p]] += a;
+			if (symmetric && A->rowind[p] != col)
+				row_sums[col] += a;
+		}
+	}
+	return row_sums.empty() ? 0.0 : *std::max_element(row_sums.begin(), row_sums.end());
+}
+
+
+static double infinity_norm(const std::vector<double>& v)
+{
+	double norm = 0;
+	for (std::size_t i = 0; i < v.size(); ++i)
+		norm = std::max(norm, std::fabs(v[i]));
+	return norm;
+}
+
+
+// Solve the symmetric positive definite system "M*x=b" with the Cholesky 
+// factorization of As, a single precision copy of M, and iterative refinement 
+// in double precision: multiply(x, y) computes y = M*x in double precision, 
+// and norm is the infinity norm of M. 
+// The refinement stops when the residual is at the level of the double 
+// precision rounding errors (as in LAPACK's dsposv). It stalls if the residual
+// does not decrease enough, or after max_iterations.
+// Return false if the factorization fails or if the refinement stalls.
+template <class Multiply>
+static bool solve_llt_refined(taucs_ccs_matrix* As,
+							  double norm_M,
+							  Multiply multiply,
+							  const std::vector<double>& b, 
+							  std::vector<double>& x,
+							  int& iterations)
+{
+	const int max_iterations = 30;
+
 	void* F = NULL;
 	char* factor[] = {"taucs.factor.LLT=true", NULL};
 	char* solve[]  = {"taucs.factor=false", NULL};
 	void* opt_arg[] = { NULL };
 
-	// factor
-	int factor_rc = taucs_linsolve(A, &F, 0, NULL, NULL, factor, opt_arg);
-	if (factor_rc != TAUCS_SUCCESS) 
-		std::cout << title() << "factorization failed" << std::endl;
-	
-	// solve
-	int solve_rc = TAUCS_ERROR;
-	for (unsigned int i=0; i<rhs.size(); ++i) {
-		solve_rc = taucs_linsolve(A, &F, 1, &(result[i][0]), (void*)&(rhs[i][0]), solve, opt_arg);
+	int factor_rc = taucs_linsolve(As, &F, 0, NULL, NULL, factor, opt_arg);
+	if (factor_rc != TAUCS_SUCCESS) {
+		std::cout << TaucsSolver::title() << "single precision factorization failed" << std::endl;
+		return false;
+	}
+
+	int n = As->n;
+	double tolerance = norm_M * std::numeric_limits<double>::epsilon() * std::sqrt(double(n));
+
+	std::vector<double> r(b);					// residual, r = b - M*x
+	std::vector<float>  rs(n), ds(n);			// single precision residual and correction
+	x.assign(n, 0.0);
+
+	bool converged = false;
+	double previous_norm = 0;
+	for (iterations = -1; iterations < max_iterations; ++iterations) {
+		if (iterations >= 0) {
+			multiply(&(x[0]), &(r[0]));
+			for (int i = 0; i < n; ++i)
+				r[i] = b[i] - r[i];
+
+			double norm = infinity_norm(r);
+			if (norm <= infinity_norm(x) * tolerance) {
+				converged = true;
+				break;
+			}
+			if (iterations > 0 && norm > 0.5 * previous_norm)
+				break;		// stalled
+			previous_norm = norm;
+		}
+
+		// x <- x + M^-1 * r in single precision
+		for (int i = 0; i < n; ++i)
+			rs[i] = static_cast<float>(r[i]);
+		int solve_rc = taucs_linsolve(As, &F, 1, &(ds[0]), &(rs[0]), solve, opt_arg);
 		if (solve_rc != TAUCS_SUCCESS) {
-			std::cout << title() << "solve for the " << i << "th vector failed" << std::endl;
+			std::cout << TaucsSolver::title() << "single precision solve failed" << std::endl;
 			break;
 		}
+		for (int i = 0; i < n; ++i)
+			x[i] += ds[i];
 	}
 
 	int free_rc = taucs_linsolve(NULL, &F, 0, NULL, NULL, factor, opt_arg);
 	if (free_rc != TAUCS_SUCCESS)
-		std::cout << title() << "free failed!" << std::endl;
+		std::cout << TaucsSolver::title() << "free failed" << std::endl;
+
+	return converged;
+}
 
-	// clean
-	//taucs_ccs_free(A); // A will be free by TaucsMatrix
 
-	return (solve_rc == TAUCS_SUCCESS) && (free_rc == TAUCS_SUCCESS);
+// Solve "A*x=b" by a double precision Cholesky factorization
+static bool solve_llt(const taucs_ccs_matrix* A, const std::vector<double>& b, std::vector<double>& x)
+{
+	x.resize(A->n);
+
+	void* F = NULL;
+	char* factor[] = {"taucs.factor.LLT=true", NULL};
+	void* opt_arg[] = { NULL };
+
+	int slove_rc = taucs_linsolve((taucs_ccs_matrix*)A, &F, 1, &(x[0]), (void*)&(b[0]), factor, opt_arg);
+	if (slove_rc != TAUCS_SUCCESS)
+		std::cout << TaucsSolver::title() << "solve failed" << std::endl;
+
+	int free_rc = taucs_linsolve(NULL, &F, 0, NULL, NULL, factor, opt_arg);
+	if (free_rc != TAUCS_SUCCESS)
+		std::cout << TaucsSolver::title() << "free failed" << std::endl;
+
+	return (slove_rc == TAUCS_SUCCESS) && (free_rc == TAUCS_SUCCESS);
 }
 
 
-bool TaucsSolver::solve_non_symmetry(const TaucsMatrix& matrix, 
-								   const std::vector<std::vector<double>>& rhs, 
-								   std::vector<std::vector<double>>& result)
+bool TaucsSolver::solve_symmetry_mixed_precision(const TaucsMatrix& matrix, 
+												 const std::vector<double>& rhs, 
+												 std::vector<double>& result,
+												 int* iterations /* = NULL */)
 {
 	int num_row = matrix.row_dimension();
 	int num_col = matrix.column_dimension();
@@ -263,143 +362,571 @@ bool TaucsSolver::solve_non_symmetry(const TaucsMatrix& matrix,
 		std::cout << title() << "num_row != num_col" << std::endl;
 		return false;
 	}
-
-	for (unsigned int i=0; i<rhs.size(); ++i) {
-		if (num_row != rhs[i].size()) {
-			std::cout << title() << "num_row != rhs.size()" << std::endl;
-			return false;
-		}	
+	
+	if (num_row != rhs.size()) {
+		std::cout << title() << "num_row != rhs.size()" << std::endl;
+		return false;
 	}
 
 	//////////////////////////////////////////////////////////////////////////
 
 	// A
 	taucs_ccs_matrix* A = (taucs_ccs_matrix*)matrix.get_taucs_matrix();
+	if (A == NULL) {
+		std::cout << title() << "can not create the TAUCS matrix" << std::endl;
+		return false;
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+
+	int nb_iterations = 0;
+	bool success = false;
+	taucs_ccs_matrix* As = TaucsUtil::MatrixCopyToSingle(A);
+	if (As == NULL)
+		std::cout << title() << "can not create the single precision matrix" << std::endl;
+	else {
+		bool symmetric = (A->flags & TAUCS_SYMMETRIC) != 0;
+		success = solve_llt_refined(As, infinity_norm(A), [A, symmetric](const double* x, double* y) {
+			if (symmetric)
+				TaucsUtil::MulSymmMatrixVector(A, x, y);
+			else
+				TaucsUtil::MulNonSymmMatrixVector(A, x, y);
+		}, rhs, result, nb_iterations);
+		taucs_ccs_free(As);
+	}
+	if (!success) {
+		std::cout << title() << "refinement stalled, using a double precision factorization" << std::endl;
+		nb_iterations = -1;
+		success = solve_llt(A, rhs, result);
+	}
 
-	// X
-	result.resize(rhs.size());
-	for (unsigned int i=0; i<result.size(); ++i)
-		result[i].resize(num_col);
+	if (iterations != NULL)
+		*iterations = nb_iterations;
+
+	return success;
+}
+
+
+bool TaucsSolver::solve_linear_least_square_mixed_precision(const TaucsMatrix& matrix, 
+															const std::vector<double>& rhs, 
+															std::vector<double>& result,
+															int* iterations /* = NULL */)
+{
+	int num_row = matrix.row_dimension();
+	int num_col = matrix.column_dimension();
+	
+	if (num_row < num_col) {
+		std::cout << title() << "num_row < num_col" << std::endl;
+		return false;
+	}
+
+	if (num_row != rhs.size()) {
+		std::cout << title() << "num_row != rhs.size()" << std::endl;
+		return false;
+	}
 
 	//////////////////////////////////////////////////////////////////////////
 
-	int*    perm = NULL;
-	int*    invperm = NULL;
+	// A^T*A, in single precision
+	NormalEquations normal_equations;
+	if (!normal_equations.compute(matrix)) {
+		std::cout << title() << "can not compute A^T * A" << std::endl;
+		return false;
+	}
+	const taucs_ccs_matrix* AtA = normal_equations.matrix().get_taucs_matrix();
+	double norm_AtA = infinity_norm(AtA);
+	taucs_ccs_matrix* AtAs = TaucsUtil::MatrixCopyToSingle(AtA);
 
-	// ordering
-	bool order_rc = true;
-	taucs_ccs_order(A, &perm, &invperm,	"colamd");
-	if ( perm == NULL || invperm == NULL) {
-		std::cout << title() << "ordering failed" << std::endl;
-		order_rc = false;
+	// The double precision A^T*A is released before the factorization: the
+	// residuals are computed with A and A^T
+	normal_equations.clear();
+	const taucs_ccs_matrix* A = matrix.get_taucs_matrix();
+
+	// A^T*b
+	std::vector<double> AtB(num_col);
+	TaucsUtil::MulNonSymmMatrixTransposeVector(A, &(rhs[0]), &(AtB[0]));
+
+	//////////////////////////////////////////////////////////////////////////
+
+	int nb_iterations = 0;
+	bool success = false;
+	if (AtAs == NULL)
+		std::cout << title() << "can not create the single precision matrix" << std::endl;
+	else {
+		std::vector<double> Ax(num_row);
+		success = solve_llt_refined(AtAs, norm_AtA, [A, &Ax](const double* x, double* y) {
+			TaucsUtil::MulNonSymmMatrixVector(A, x, &(Ax[0]));
+			TaucsUtil::MulNonSymmMatrixTransposeVector(A, &(Ax[0]), y);
+		}, AtB, result, nb_iterations);
+		taucs_ccs_free(AtAs);
 	}
+	if (!success) {
+		std::cout << title() << "refinement stalled, using a double precision factorization" << std::endl;
+		nb_iterations = -1;
+		success = normal_equations.compute(matrix) && 
+			solve_llt(normal_equations.matrix().get_taucs_matrix(), AtB, result);
+	}
+
+	if (iterations != NULL)
+		*iterations = nb_iterations;
 
-	bool multfile_rc = true;
-	taucs_io_handle* LU = taucs_io_create_multifile("taucs.L");
-	if (LU == NULL) {
-		std::cout << title() << "can not create multifile" << std::endl;
-		multfile_rc = false;
+	return success;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// iterative api
+
+static double dot(const std::vector<double>& u, const std::vector<double>& v)
+{
+	double sum = 0;
+	for (std::size_t i = 0; i < u.size(); ++i)
+		sum += u[i] * v[i];
+	return sum;
+}
+
+
+// Copy the symmetric matrix A (lower triangle), with its diagonal scaled by
+// (1 + shift). Return NULL if an element of the diagonal is missing.
+static taucs_ccs_matrix* shifted_copy(const taucs_ccs_matrix* A, double shift)
+{
+	taucs_ccs_matrix* S = TaucsUtil::MatrixCopy(A);
+	if (S == NULL)
+		return NULL;
+	for (int j = 0; j < S->n; ++j) {
+		// the rows are sorted: the diagonal comes first
+		int p = S->colptr[j];
+		if (p == S->colptr[j + 1] || S->rowind[p] != j) {
+			taucs_ccs_free(S);
+			return NULL;
+		}
+		S->taucs_values[p] *= 1.0 + shift;
 	}
+	return S;
+}
 
-	// factorization
-	int memory_mb = int(taucs_available_memory_size() / 1048576.0);
-	int factor_rc = taucs_ooc_factor_lu(A, perm, LU, memory_mb * 1048576.0);
-	if (factor_rc != TAUCS_SUCCESS)
-		std::cout << title() << "factorization failed" << std::endl;
 
-	// solve
-	int solve_rc = TAUCS_ERROR;
-	for (unsigned int i=0; i<rhs.size(); ++i) {
-		solve_rc = taucs_ooc_solve_lu(LU, &(result[i][0]), (void*)&(rhs[i][0]));
-		if (solve_rc != TAUCS_SUCCESS) {
-			std::cout << title() << "solve for the " << i << "th vector failed" << std::endl;
-			break;
+// The incomplete Cholesky factor of the symmetric matrix A (lower triangle,
+// sorted rows) with the pattern of A (IC(0)): L*L^T ~ A. Return NULL if the
+// factorization breaks down (a pivot is not positive).
+static taucs_ccs_matrix* incomplete_cholesky_0(const taucs_ccs_matrix* A, double shift)
+{
+	taucs_ccs_matrix* L = shifted_copy(A, shift);
+	if (L == NULL)
+		return NULL;
+	L->flags = TAUCS_DOUBLE | TAUCS_LOWER | TAUCS_TRIANGULAR;
+
+	int n = L->n;
+	std::vector<int> position(n, -1);	// the position of each row in column j
+	for (int k = 0; k < n; ++k) {
+		double d = L->taucs_values[L->colptr[k]];
+		if (d <= 0) {
+			taucs_ccs_free(L);
+			return NULL;
+		}
+		d = std::sqrt(d);
+		L->taucs_values[L->colptr[k]] = d;
+		for (int p = L->colptr[k] + 1; p < L->colptr[k + 1]; ++p)
+			L->taucs_values[p] /= d;
+
+		// L(i,j) -= L(i,k)*L(j,k) for the elements (i,j) of the pattern, j > k
+		for (int p = L->colptr[k] + 1; p < L->colptr[k + 1]; ++p) {
+			int j = L->rowind[p];
+			double ljk = L->taucs_values[p];
+			for (int q = L->colptr[j]; q < L->colptr[j + 1]; ++q)
+				position[L->rowind[q]] = q;
+			for (int q = p; q < L->colptr[k + 1]; ++q) {
+				int pos = position[L->rowind[q]];
+				if (pos >= 0)
+					L->taucs_values[pos] -= L->taucs_values[q] * ljk;
+			}
+			for (int q = L->colptr[j]; q < L->colptr[j + 1]; ++q)
+				position[L->rowind[q]] = -1;
 		}
 	}
+	return L;
+}
 
-	// delete the temporal multifile
-	int delete_rc = taucs_io_delete(LU);
-	if (delete_rc != TAUCS_SUCCESS) 
-		std::cout << title() << "delete multifile file failed" << std::endl;
 
-	// clean
-	//taucs_ccs_free(A); // A will be free by TaucsMatrix
+// The (incomplete) Cholesky factor of the symmetric matrix A (lower triangle)
+// for the drop tolerance (0 for the complete factor), after a fill-reducing
+// ordering: P*A*P^T ~ L*L^T, where row k of P*A*P^T is row perm[k] of A. The
+// diagonal comes first in each column of L. Return NULL if the factorization
+// breaks down.
+static taucs_ccs_matrix* incomplete_cholesky(const taucs_ccs_matrix* A, double drop_tolerance, double shift, std::vector<int>& perm)
+{
+	taucs_ccs_matrix* S = shifted_copy(A, shift);
+	if (S == NULL)
+		return NULL;
+
+	int* p = NULL;
+	int* ip = NULL;
+	taucs_ccs_order(S, &p, &ip, "amd");
+	if (p == NULL || ip == NULL) {
+		taucs_free(p);
+		taucs_free(ip);
+		taucs_ccs_free(S);
+		return NULL;
+	}
 
-	return order_rc && multfile_rc && (factor_rc == TAUCS_SUCCESS) && (solve_rc == TAUCS_SUCCESS) && (delete_rc == TAUCS_SUCCESS);
+	taucs_ccs_matrix* PAPT = taucs_ccs_permute_symmetrically(S, p, ip);
+	perm.assign(p, p + A->n);
+	taucs_free(p);
+	taucs_free(ip);
+	taucs_ccs_free(S);
+	if (PAPT == NULL)
+		return NULL;
+
+	taucs_ccs_matrix* L = taucs_ccs_factor_llt(PAPT, drop_tolerance, 0);
+	taucs_ccs_free(PAPT);
+	if (L == NULL)
+		return NULL;
+
+	for (int j = 0; j < L->n; ++j) {
+		for (int k = L->colptr[j]; k < L->colptr[j + 1]; ++k) {
+			if (L->rowind[k] == j) {
+				std::swap(L->rowind[k], L->rowind[L->colptr[j]]);
+				std::swap(L->taucs_values[k], L->taucs_values[L->colptr[j]]);
+				break;
+			}
+		}
+	}
+	return L;
 }
 
 
-bool TaucsSolver::solve_linear_least_square(const TaucsMatrix& matrix, 
-											const std::vector<std::vector<double>>& rhs, 
-											std::vector<std::vector<double>>& result)
+// x = L^-1 * x, for L lower triangular (diagonal first in each column)
+static void solve_lower(const taucs_ccs_matrix* L, double* x)
+{
+	for (int j = 0; j < L->n; ++j) {
+		x[j] /= L->taucs_values[L->colptr[j]];
+		for (int p = L->colptr[j] + 1; p < L->colptr[j + 1]; ++p)
+			x[L->rowind[p]] -= L->taucs_values[p] * x[j];
+	}
+}
+
+
+// x = L^-T * x, for L lower triangular (diagonal first in each column)
+static void solve_lower_transpose(const taucs_ccs_matrix* L, double* x)
+{
+	for (int j = L->n - 1; j >= 0; --j) {
+		for (int p = L->colptr[j] + 1; p < L->colptr[j + 1]; ++p)
+			x[j] -= L->taucs_values[p] * x[L->rowind[p]];
+		x[j] /= L->taucs_values[L->colptr[j]];
+	}
+}
+
+
+// A preconditioner M = R^T*R of a symmetric positive definite matrix, with
+// R = L^T*P:
+// - JACOBI: L = diag(d)^(1/2) for the diagonal d of the matrix, P = I;
+// - INCOMPLETE_CHOLESKY_0: the IC(0) factor, P = I;
+// - INCOMPLETE_CHOLESKY: the drop tolerance factor, P the amd ordering;
+// - VAIDYA: the complete factor of Vaidya's preconditioner (a maximum 
+//   spanning tree of the graph of the matrix, augmented by subgraphs).
+// If an incomplete factorization breaks down, the diagonal of the matrix is
+// increased (by 0.1%, 1%, ...) until it succeeds.
+class CholeskyPreconditioner
+{
+public:
+	CholeskyPreconditioner() : m_type(TaucsSolver::NO_PRECONDITIONER), m_L(NULL) {}
+	~CholeskyPreconditioner() { if (m_L != NULL) taucs_ccs_free(m_L); }
+
+	// JACOBI for the diagonal d (the zeros are replaced by 1)
+	void create_diagonal(const std::vector<double>& d) {
+		m_type = TaucsSolver::JACOBI;
+		m_scale.resize(d.size());
+		for (std::size_t j = 0; j < d.size(); ++j)
+			m_scale[j] = (d[j] > 0) ? std::sqrt(d[j]) : 1.0;
+	}
+
+	// The preconditioner of options for the symmetric matrix A (lower triangle)
+	bool create(const taucs_ccs_matrix* A, const TaucsSolver::IterativeOptions& options) {
+		m_type = options.preconditioner;
+		if (m_type == TaucsSolver::NO_PRECONDITIONER)
+			return true;
+
+		if (m_type == TaucsSolver::JACOBI) {
+			std::vector<double> d(A->n, 0.0);
+			for (int j = 0; j < A->n; ++j) {
+				if (A->colptr[j] < A->colptr[j + 1] && A->rowind[A->colptr[j]] == j)
+					d[j] = A->taucs_values[A->colptr[j]];
+			}
+			create_diagonal(d);
+			return true;
+		}
+
+		m_work.resize(A->n);
+		if (m_type == TaucsSolver::VAIDYA) {
+			taucs_ccs_matrix* V = taucs_amwb_preconditioner_create((taucs_ccs_matrix*)A, 1, options.subgraphs, 0);
+			if (V == NULL)
+				return false;
+			m_L = incomplete_cholesky(V, 0.0, 0.0, m_perm);
+			taucs_ccs_free(V);
+			return m_L != NULL;
+		}
+
+		for (double shift = 0; shift < 1; shift = (shift == 0) ? 1e-3 : shift * 10) {
+			if (m_type == TaucsSolver::INCOMPLETE_CHOLESKY_0)
+				m_L = incomplete_cholesky_0(A, shift);
+			else
+				m_L = incomplete_cholesky(A, options.drop_tolerance, shift, m_perm);
+			if (m_L != NULL)
+				return true;
+		}
+		return false;
+	}
+
+	// x = R^-T * x = L^-1 * P * x
+	void solve_transpose(std::vector<double>& x) {
+		if (m_type == TaucsSolver::JACOBI) {
+			for (std::size_t j = 0; j < x.size(); ++j)
+				x[j] /= m_scale[j];
+		}
+		else if (m_L != NULL) {
+			if (!m_perm.empty()) {
+				for (std::size_t k = 0; k < x.size(); ++k)
+					m_work[k] = x[m_perm[k]];
+				x.swap(m_work);
+			}
+			solve_lower(m_L, &(x[0]));
+		}
+	}
+
+	// x = R^-1 * x = P^T * L^-T * x
+	void solve(std::vector<double>& x) {
+		if (m_type == TaucsSolver::JACOBI) {
+			for (std::size_t j = 0; j < x.size(); ++j)
+				x[j] /= m_scale[j];
+		}
+		else if (m_L != NULL) {
+			solve_lower_transpose(m_L, &(x[0]));
+			if (!m_perm.empty()) {
+				for (std::size_t k = 0; k < x.size(); ++k)
+					m_work[m_perm[k]] = x[k];
+				x.swap(m_work);
+			}
+		}
+	}
+
+	// x = M^-1 * x
+	void solve_both(std::vector<double>& x) {
+		solve_transpose(x);
+		solve(x);
+	}
+
+private:
+	TaucsSolver::Preconditioner	m_type;
+	std::vector<double>	m_scale;
+	taucs_ccs_matrix*	m_L;
+	std::vector<int>	m_perm;
+	std::vector<double>	m_work;
+};
+
+
+bool TaucsSolver::solve_symmetry_iterative(const TaucsMatrix& matrix, 
+										   const std::vector<double>& rhs, 
+										   std::vector<double>& result,
+										   const IterativeOptions& options,
+										   IterativeReport* report)
 {
 	int num_row = matrix.row_dimension();
 	int num_col = matrix.column_dimension();
 
-	if (num_row < num_col) {
-		std::cout << title() << "num_row < num_col" << std::endl;
+	if (num_row != num_col) {
+		std::cout << title() << "num_row != num_col" << std::endl;
 		return false;
 	}
 
-	for (unsigned int i=0; i<rhs.size(); ++i) {
-		if (num_row != rhs[i].size()) {
-			std::cout << title() << "num_row != rhs.size()" << std::endl;
-			return false;
-		}	
+	if (num_row != rhs.size()) {
+		std::cout << title() << "num_row != rhs.size()" << std::endl;
+		return false;
+	}
+
+	const taucs_ccs_matrix* A = matrix.get_taucs_matrix();
+	if (A == NULL) {
+		std::cout << title() << "can not create the TAUCS matrix" << std::endl;
+		return false;
+	}
+	if ((A->flags & TAUCS_SYMMETRIC) == 0) {
+		std::cout << title() << "A is not symmetric" << std::endl;
+		return false;
+	}
+
+	CholeskyPreconditioner M;
+	if (!M.create(A, options)) {
+		std::cout << title() << "can not compute the preconditioner" << std::endl;
+		return false;
 	}
 
 	//////////////////////////////////////////////////////////////////////////
+	// preconditioned conjugate gradients
+
+	int n = num_col;
+	if (!options.use_initial_guess || result.size() != n)
+		result.assign(n, 0.0);
+	std::vector<double>& x = result;
+
+	std::vector<double> r(n), z(n), p(n), q(n);		// r = b - A*x
+	double norm_b = std::sqrt(dot(rhs, rhs));
+
+	TaucsUtil::MulSymmMatrixVector(A, &(x[0]), &(r[0]));
+	for (int i = 0; i < n; ++i)
+		r[i] = rhs[i] - r[i];
+	double residual = (norm_b > 0) ? std::sqrt(dot(r, r)) / norm_b : 0;
+
+	z = r;
+	M.solve_both(z);
+	p = z;
+	double rz = dot(r, z);
+
+	int iterations = 0;
+	while (residual > options.tolerance && iterations < options.max_iterations) {
+		TaucsUtil::MulSymmMatrixVector(A, &(p[0]), &(q[0]));
+		double pq = dot(p, q);
+		if (pq <= 0) {
+			std::cout << title() << "A is not positive definite" << std::endl;
+			break;
+		}
+		double alpha = rz / pq;
+		for (int i = 0; i < n; ++i) {
+			x[i] += alpha * p[i];
+			r[i] -= alpha * q[i];
+		}
+		++iterations;
+		residual = std::sqrt(dot(r, r)) / norm_b;
+
+		z = r;
+		M.solve_both(z);
+		double rz_new = dot(r, z);
+		double beta = rz_new / rz;
+		rz = rz_new;
+		for (int i = 0; i < n; ++i)
+			p[i] = z[i] + beta * p[i];
+	}
 
-	// AtA
-	taucs_ccs_matrix* A = (taucs_ccs_matrix*)matrix.get_taucs_matrix();
-	taucs_ccs_matrix* At = TaucsUtil::MatrixTranspose(A);
-	taucs_ccs_matrix* AtA = TaucsUtil::Mul2NonSymmMatSymmResult(At, A);
+	bool converged = (residual <= options.tolerance);
+	if (report != NULL) {
+		report->iterations = iterations;
+		report->residual = residual;
+		report->converged = converged;
+	}
+	if (!converged)
+		std::cout << title() << "conjugate gradients did not converge (relative residual " << residual << " after " << iterations << " iterations)" << std::endl;
 
-	// AtB
-	std::vector<std::vector<double>> AtB(rhs.size());
-	for (unsigned int i=0; i<rhs.size(); ++i) {
-		AtB[i].resize(num_col);
-		TaucsUtil::MulNonSymmMatrixVector(At, &(rhs[i][0]), &(AtB[i][0]));
+	return converged;
+}
+
+
+bool TaucsSolver::solve_linear_least_square_iterative(const TaucsMatrix& matrix, 
+													  const std::vector<double>& rhs, 
+													  std::vector<double>& result,
+													  const IterativeOptions& options,
+													  IterativeReport* report)
+{
+	int num_row = matrix.row_dimension();
+	int num_col = matrix.column_dimension();
+
+	if (num_row < num_col) {
+		std::cout << title() << "num_row < num_col" << std::endl;
+		return false;
 	}
 
-	// X
-	result.resize(rhs.size());
-	for (unsigned int i=0; i<rhs.size(); ++i) {
-		result[i].resize(num_col);
+	if (num_row != rhs.size()) {
+		std::cout << title() << "num_row != rhs.size()" << std::endl;
+		return false;
 	}
 
-	//////////////////////////////////////////////////////////////////////////
-	// first factor, then solve, then free 
+	const taucs_ccs_matrix* A = matrix.get_taucs_matrix();
+	if (A == NULL) {
+		std::cout << title() << "can not create the TAUCS matrix" << std::endl;
+		return false;
+	}
+	if ((A->flags & TAUCS_SYMMETRIC) != 0) {
+		std::cout << title() << "A is symmetric" << std::endl;
+		return false;
+	}
 
-	void* F = NULL;
-	char* factor[] = {"taucs.factor.LLT=true", NULL};
-	char* solve[]  = {"taucs.factor=false", NULL};
-	void* opt_arg[] = { NULL };
-	
-	// factor
-	int factor_rc = taucs_linsolve(AtA, &F, 0, NULL, NULL, factor, opt_arg);
-	if (factor_rc != TAUCS_SUCCESS) 
-		std::cout << title() << "factorization failed" << std::endl;
-
-	// solve
-	int solve_rc = TAUCS_ERROR;
-	for (unsigned int i=0; i<AtB.size(); ++i) {
-		solve_rc = taucs_linsolve(AtA, &F, 1, &(result[i][0]), &(AtB[i][0]), solve, opt_arg);
-		if (solve_rc != TAUCS_SUCCESS) {
-			std::cout << title() << "solve for the " << i << "th vector failed" << std::endl;
-			break;
+	// the preconditioner of A^T*A: the column norms of A for JACOBI (without
+	// forming A^T*A)
+	CholeskyPreconditioner R;
+	bool created = true;
+	if (options.preconditioner == JACOBI) {
+		std::vector<double> d(num_col, 0.0);
+		for (int j = 0; j < num_col; ++j) {
+			for (int p = A->colptr[j]; p < A->colptr[j + 1]; ++p)
+				d[j] += A->taucs_values[p] * A->taucs_values[p];
 		}
+		R.create_diagonal(d);
+	}
+	else if (options.preconditioner != NO_PRECONDITIONER) {
+		NormalEquations normal_equations;
+		created = normal_equations.compute(matrix) && R.create(normal_equations.matrix().get_taucs_matrix(), options);
+		A = matrix.get_taucs_matrix();		// (NormalEquations called it again)
+	}
+	if (!created) {
+		std::cout << title() << "can not compute the preconditioner" << std::endl;
+		return false;
 	}
 
-	// free
-	int free_rc = taucs_linsolve(NULL, &F, 0, NULL, NULL, factor, opt_arg);
-	if (free_rc != TAUCS_SUCCESS)
-		std::cout << title() << "free failed" << std::endl;
+	//////////////////////////////////////////////////////////////////////////
+	// CGLS (Bjorck), preconditioned on the right
+
+	if (!options.use_initial_guess || result.size() != num_col)
+		result.assign(num_col, 0.0);
+	std::vector<double>& x = result;
+
+	std::vector<double> r(num_row), q(num_row);		// r = b - A*x
+	std::vector<double> g(num_col), s(num_col), p(num_col), t(num_col);
+
+	TaucsUtil::MulNonSymmMatrixTransposeVector(A, &(rhs[0]), &(g[0]));
+	double norm_Atb = std::sqrt(dot(g, g));
+
+	TaucsUtil::MulNonSymmMatrixVector(A, &(x[0]), &(r[0]));
+	for (int i = 0; i < num_row; ++i)
+		r[i] = rhs[i] - r[i];
+	TaucsUtil::MulNonSymmMatrixTransposeVector(A, &(r[0]), &(g[0]));
+	double residual = (norm_Atb > 0) ? std::sqrt(dot(g, g)) / norm_Atb : 0;
+
+	s = g;
+	R.solve_transpose(s);
+	p = s;
+	double gamma = dot(s, s);
+
+	int iterations = 0;
+	while (residual > options.tolerance && iterations < options.max_iterations) {
+		t = p;
+		R.solve(t);
+		TaucsUtil::MulNonSymmMatrixVector(A, &(t[0]), &(q[0]));
+		double qq = dot(q, q);
+		if (qq <= 0)
+			break;
+		double alpha = gamma / qq;
+		for (int j = 0; j < num_col; ++j)
+			x[j] += alpha * t[j];
+		for (int i = 0; i < num_row; ++i)
+			r[i] -= alpha * q[i];
+		++iterations;
+
+		TaucsUtil::MulNonSymmMatrixTransposeVector(A, &(r[0]), &(g[0]));
+		residual = std::sqrt(dot(g, g)) / norm_Atb;
+
+		s = g;
+		R.solve_transpose(s);
+		double gamma_new = dot(s, s);
+		double beta = gamma_new / gamma;
+		gamma = gamma_new;
+		for (int j = 0; j < num_col; ++j)
+			p[j] = s[j] + beta * p[j];
+	}
 
-	// clean
-	//taucs_ccs_free(A); // A will be free by TaucsMatrix
-	taucs_ccs_free(At);
-	taucs_ccs_free(AtA);
+	bool converged = (residual <= options.tolerance);
+	if (report != NULL) {
+		report->iterations = iterations;
+		report->residual = residual;
+		report->converged = converged;
+	}
+	if (!converged)
+		std::cout << title() << "CGLS did not converge (relative residual " << residual << " after " << iterations << " iterations)" << std::endl;
 
-	return (factor_rc == TAUCS_SUCCESS) && (solve_rc == TAUCS_SUCCESS) && (free_rc == TAUCS_SUCCESS);
-}
\ No newline at end of file
+	return converged;
+}
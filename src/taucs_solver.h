@@ -37,6 +37,42 @@ class TaucsSolver
 public:
 	static std::string title() { return "[TaucsSolver]: "; }
 
+	// The preconditioners of the iterative solvers
+	// (of A^T*A for least squares, which is then formed, except for JACOBI)
+	enum Preconditioner {
+		NO_PRECONDITIONER,
+		JACOBI,					// the diagonal
+		INCOMPLETE_CHOLESKY_0,	// incomplete Cholesky factor with the pattern of A (IC(0))
+		INCOMPLETE_CHOLESKY,	// incomplete Cholesky factor with a drop tolerance, after
+								// an amd ordering
+		VAIDYA					// Vaidya's support-graph preconditioner (for diagonally 
+								// dominant matrices), factored
+	};
+
+	// The options of the iterative solvers
+	struct IterativeOptions {
+		IterativeOptions() : tolerance(1e-10), max_iterations(1000), preconditioner(JACOBI), 
+			drop_tolerance(1e-3), subgraphs(1.0), use_initial_guess(false) {}
+
+		double			tolerance;			// the relative residual at which the iterations stop
+		int				max_iterations;
+		Preconditioner	preconditioner;
+		double			drop_tolerance;		// INCOMPLETE_CHOLESKY: the drop tolerance of the factor
+											// (taucs_ccs_factor_llt), 0 to keep all its elements
+		double			subgraphs;			// VAIDYA: the number of subgraphs added to the spanning
+											// tree (taucs_amwb_preconditioner_create)
+		bool			use_initial_guess;	// start from x (if it has the right size) instead of 0
+	};
+
+	// The outcome of an iterative solve
+	struct IterativeReport {
+		IterativeReport() : iterations(0), residual(0), converged(false) {}
+
+		int		iterations;
+		double	residual;		// the relative residual of the result
+		bool	converged;
+	};
+
 	// solve for "A*x=b"
 	// A: the symmetry coefficient matrix, 
 	// b: the right side column vector
@@ -46,6 +82,16 @@ public:
 		const std::vector<double>& b, 
 		std::vector<double>& x
 		);
+
+	// solve for "A*x=b" with the LDL^T factorization (see TaucsFactorization)
+	// A: the symmetry indefinite coefficient matrix (e.g., a KKT matrix), 
+	// b: the right side column vector
+	// x: the result
+	static bool solve_symmetry_indefinite(
+		const TaucsMatrix& A, 
+		const std::vector<double>& b, 
+		std::vector<double>& x
+		);
 	
 	
 	// solve for "A*x=b"
@@ -72,6 +118,7 @@ public:
 	//////////////////////////////////////////////////////////////////////////
 
 	// API for an array of rhs using the same matrix
+	// (see TaucsFactorization for rhs that are not all known at once)
 
 	// solve for "A*x=b"
 	// A: the symmetry coefficient matrix, 
@@ -83,6 +130,16 @@ public:
 		std::vector<std::vector<double>>& X
 		);
 
+	// solve for "A*x=b" with the LDL^T factorization
+	// A: the symmetry indefinite coefficient matrix, 
+	// B: the array of right side column vector
+	// X: the array of result vectors
+	static bool solve_symmetry_indefinite(
+		const TaucsMatrix& A, 
+		const std::vector<std::vector<double>>& B, 
+		std::vector<std::vector<double>>& X
+		);
+
 	// solve for "A*x=b"
 	// A: the non-symmetry coefficient matrix, 
 	// B: the array of right side column vector
@@ -102,6 +159,79 @@ public:
 		const std::vector<std::vector<double>>& B, 
 		std::vector<std::vector<double>>& X
 		);
+
+	//////////////////////////////////////////////////////////////////////////
+
+	// Iterative API: the solution is computed with products by the matrix only,
+	// without factoring it, so that the memory is proportional to the number of
+	// nonzeros of A (plus that of the preconditioner, see Preconditioner).
+	// Return false if the iterations did not converge (x is then the last 
+	// iterate) or if the preconditioner can not be computed.
+
+	// solve for "A*x=b" by preconditioned conjugate gradients.
+	// The residual is ||b - A*x|| / ||b||.
+	// A: the symmetry positive definite coefficient matrix, 
+	// b: the right side column vector
+	// x: the result (and the initial guess, see IterativeOptions)
+	static bool solve_symmetry_iterative(
+		const TaucsMatrix& A, 
+		const std::vector<double>& b, 
+		std::vector<double>& x,
+		const IterativeOptions& options = IterativeOptions(),
+		IterativeReport* report = NULL
+		);
+
+	// solve for "A*x=b" in least square sence by CGLS (conjugate gradients on
+	// the normal equations, with products by A and A^T, which are not formed).
+	// The residual is ||A^T*(b - A*x)|| / ||A^T*b||.
+	// A: the coefficient m * n matrix (m >= n)
+	// b: the right side column vector
+	// x: the result (and the initial guess, see IterativeOptions)
+	static bool solve_linear_least_square_iterative(
+		const TaucsMatrix& A, 
+		const std::vector<double>& b, 
+		std::vector<double>& x,
+		const IterativeOptions& options = IterativeOptions(),
+		IterativeReport* report = NULL
+		);
+
+	//////////////////////////////////////////////////////////////////////////
+
+	// Mixed precision API: the matrix is factored in single precision (half
+	// the memory and bandwidth of a double precision factor), and the solution
+	// is refined to double precision accuracy using residuals computed in 
+	// double precision. If the refinement stalls (e.g., A is too ill-conditioned
+	// for single precision), A is factored in double precision instead.
+	// iterations: if not NULL, receives the number of refinement iterations,
+	//             or -1 if the double precision factorization was used.
+
+	// solve for "A*x=b"
+	// A: the symmetry coefficient matrix, 
+	// b: the right side column vector
+	// x: the result
+	static bool solve_symmetry_mixed_precision(
+		const TaucsMatrix& A, 
+		const std::vector<double>& b, 
+		std::vector<double>& x,
+		int* iterations = NULL
+		);
+
+	// solve for "A*x=b" in least square sence (refining the solution of the 
+	// normal equations A^T*A*x = A^T*b)
+	// Note: A^T*A is formed in double precision, then copied to single 
+	// precision and released before the factorization (the residuals are 
+	// computed with A and A^T). The factor takes half the memory, but the 
+	// peak memory of the setup is that of both copies of A^T*A, so the 2x 
+	// memory saving does not hold for this entry point.
+	// A: the coefficient m * n matrix (m >= n)
+	// b: the right side column vector
+	// x: the result
+	static bool solve_linear_least_square_mixed_precision(
+		const TaucsMatrix& A, 
+		const std::vector<double>& b, 
+		std::vector<double>& x,
+		int* iterations = NULL
+		);
 };
 
 
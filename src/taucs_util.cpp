@@ -1,22 +1,112 @@
 #include "taucs_util.h"
+#include "parallel.h"
 
 #define  TAUCS_CORE_DOUBLE
 extern "C" {
 #include <taucs.h>
 }
 
+#include <algorithm>
 #include <cassert>
+#include <cstring>
+#include <limits>
 
 
 
 namespace TaucsUtil {
 
+	// Computes C = A*B (Gustavson): the columns of C are computed independently,
+	// in parallel, in two passes over the columns of B. The first one counts the
+	// nonzeros of each column of C (which gives colptr), the second one 
+	// accumulates the values in a dense array and sorts the row indices. If 
+	// lower is true, only the lower triangle of C is computed.
+	// The values are summed in the same order as the columns of B and A are 
+	// traversed. Returns NULL if C has more than 2^31-1 nonzeros.
+	static taucs_ccs_matrix* MulMatrices(const taucs_ccs_matrix* matA,
+		const taucs_ccs_matrix* matB,
+		bool lower,
+		int flags)
+	{
+		int m = matA->m;
+		int k = matB->n;
+		int num_threads = std::max(1, std::min(Parallel::default_num_threads(), k));
+
+		// symbolic pass: the number of nonzeros of each column of C
+		std::vector<int> colptr(k + 1, 0);
+		Parallel::for_each_range(num_threads, 0, k, [&](int, int begin, int end) {
+			std::vector<int> mark(m, -1);
+			for (int i = begin; i < end; ++i) {
+				int count = 0;
+				for (int rowptrBi = matB->colptr[i]; rowptrBi < matB->colptr[i+1]; ++rowptrBi) {
+					int rowInd = matB->rowind[rowptrBi];
+					for (int rowptrA = matA->colptr[rowInd]; rowptrA < matA->colptr[rowInd+1]; ++rowptrA) {
+						int rowA = matA->rowind[rowptrA];
+						if ((!lower || rowA >= i) && mark[rowA] != i) {
+							mark[rowA] = i;
+							++count;
+						}
+					}
+				}
+				colptr[i + 1] = count;
+			}
+		});
+
+		std::size_t count = 0;
+		for (int i = 0; i < k; ++i) {
+			count += colptr[i + 1];
+			if (count > static_cast<std::size_t>(std::numeric_limits<int>::max()))
+				return NULL;
+			colptr[i + 1] = static_cast<int>(count);
+		}
+
+		taucs_ccs_matrix* matC = taucs_ccs_create(m, k, colptr[k], flags);
+		if (! matC)
+			return NULL;
+		memcpy(matC->colptr, &colptr[0], sizeof(int) * (k + 1));
+
+		// numeric pass
+		Parallel::for_each_range(num_threads, 0, k, [&](int, int begin, int end) {
+			std::vector<int>    mark(m, -1);
+			std::vector<double> values(m);
+			for (int i = begin; i < end; ++i) {
+				int* rows = matC->rowind + matC->colptr[i];
+				int nnz = 0;
+				for (int rowptrBi = matB->colptr[i]; rowptrBi < matB->colptr[i+1]; ++rowptrBi) {
+					int rowInd = matB->rowind[rowptrBi];
+					double biv = matB->taucs_values[rowptrBi];
+					for (int rowptrA = matA->colptr[rowInd]; rowptrA < matA->colptr[rowInd+1]; ++rowptrA) {
+						int rowA = matA->rowind[rowptrA];
+						if (lower && rowA < i)
+							continue;
+						double valA = matA->taucs_values[rowptrA];
+						if (mark[rowA] != i) {
+							// first time
+							mark[rowA] = i;
+							values[rowA] = valA*biv;
+							rows[nnz++] = rowA;
+						}
+						else
+							values[rowA] = values[rowA] + valA*biv;
+					}
+				}
+
+				std::sort(rows, rows + nnz);
+				double* vals = matC->taucs_values + matC->colptr[i];
+				for (int p = 0; p < nnz; ++p)
+					vals[p] = values[rows[p]];
+			}
+		});
+
+		return matC;
+	}
+
+
 	// Assuming nothing about the result (the result is NOT stored symmetric).
 	taucs_ccs_matrix* Mul2NonSymmetricMatrices(const taucs_ccs_matrix* matA,
 		const taucs_ccs_matrix* matB) 
 	{
 		// Compatibility of dimensions        
-		if (matA->m != matB->n)
+		if (matA->n != matB->m)
 			return NULL;
 
 		if ((matA->flags & TAUCS_SYMMETRIC) ||
@@ -24,39 +114,7 @@ namespace TaucsUtil {
 			return NULL;
 
 		// (m x n)*(n x k) = (m x k)
-		int m=matA->m;
-		int n=matA->n;
-		int k=matB->n;
-
-		double biv, valA;
-		int rowInd, rowA;
-		std::vector<std::map<int, double> > rowsC(k);
-		for (int i=0; i<k; ++i) {
-			// creating column i of C
-			std::map<int, double> & mapRow2Val = rowsC[i];
-			// travel on bi
-			for (int rowptrBi = matB->colptr[i];rowptrBi < matB->colptr[i+1];++rowptrBi) {
-				rowInd = matB->rowind[rowptrBi];
-				biv = matB->taucs_values[rowptrBi];
-				// make biv*a_{rowInd} and insert into mapRow2Val
-				for (int rowptrA=matA->colptr[rowInd];rowptrA<matA->colptr[rowInd+1];++rowptrA) {
-					rowA=matA->rowind[rowptrA];
-					valA=matA->taucs_values[rowptrA];
-					// insert valA*biv into map
-					std::map<int, double>::iterator it = mapRow2Val.find(rowA);
-					if (it == mapRow2Val.end()) {
-						// first time
-						mapRow2Val[rowA] = valA*biv;
-					}
-					else {
-						it->second = it->second + valA*biv;
-					}
-				}
-			}
-			// now column i is created
-		}
-
-		return CreateTaucsMatrixFromColumns(rowsC,m,TAUCS_DOUBLE);
+		return MulMatrices(matA, matB, false, TAUCS_DOUBLE);
 	}
 
 	// For usage when it's known that the result is symmetric, like A^double * A.
@@ -72,41 +130,8 @@ namespace TaucsUtil {
 			return NULL;
 
 		// (m x n)*(n x m) = (m x m)
-		int m=matA->m;
-		int n=matA->n;
-
-		double biv, valA;
-		int rowInd, rowA;
-		std::vector<std::map<int, double> > rowsC(m);
-		for (int i=0; i<m; ++i) {
-			// creating column i of C
-			std::map<int, double> & mapRow2Val = rowsC[i];
-			// travel on bi
-			for (int rowptrBi = matB->colptr[i];rowptrBi < matB->colptr[i+1];++rowptrBi) {
-				rowInd = matB->rowind[rowptrBi];
-				biv = matB->taucs_values[rowptrBi];
-				// make biv*a_{rowInd} and insert into mapRow2Val
-				// Ignore anything above the diagonal!!
-				for (int rowptrA=matA->colptr[rowInd];rowptrA<matA->colptr[rowInd+1];++rowptrA) {
-					rowA=matA->rowind[rowptrA];
-					if (rowA >= i) {
-						valA=matA->taucs_values[rowptrA];
-						// insert valA*biv into map
-						std::map<int, double>::iterator it = mapRow2Val.find(rowA);
-						if (it == mapRow2Val.end()) {
-							// first time
-							mapRow2Val[rowA] = valA*biv;
-						}
-						else {
-							it->second = it->second + valA*biv;
-						}
-					}
-				}
-			}
-			// now column i is created
-		}
-
-		return CreateTaucsMatrixFromColumns(rowsC, m, TAUCS_DOUBLE|TAUCS_SYMMETRIC|TAUCS_LOWER);
+		// Ignore anything above the diagonal!!
+		return MulMatrices(matA, matB, true, TAUCS_DOUBLE|TAUCS_SYMMETRIC|TAUCS_LOWER);
 	}
 
 
@@ -166,11 +191,16 @@ namespace TaucsUtil {
 		// count nnz:
 		int nCols = (int)cols.size();
 
-		int nnz = 0;
+		std::size_t count = 0;
 		for (int counter=0; counter < nCols; ++counter) {
-			nnz += (int)cols[counter].size();
+			count += cols[counter].size();
 		}
 
+		// TAUCS indexes the elements with int
+		if (count > static_cast<std::size_t>(std::numeric_limits<int>::max()))
+			return NULL;
+		int nnz = static_cast<int>(count);
+
 		taucs_ccs_matrix *matC = taucs_ccs_create(nRows,nCols,nnz,flags);
 		if (! matC)
 			return NULL;
@@ -193,6 +223,94 @@ namespace TaucsUtil {
 	}
 
 
+	taucs_ccs_matrix* CreateTaucsMatrixFromTriplets(
+		int nRows,
+		int nCols,
+		int nTriplets,
+		const int* rows,
+		const int* cols,
+		const double* values,
+		int flags)
+	{
+		bool symmetric = (flags & TAUCS_SYMMETRIC) != 0;
+
+		// count the triplets of each column (colptr[c+1])
+		std::vector<int> colptr(nCols + 1, 0);
+		for (int k = 0; k < nTriplets; ++k) {
+			if (rows[k] < 0 || rows[k] >= nRows || cols[k] < 0 || cols[k] >= nCols)
+				return NULL;
+			if (symmetric && cols[k] > rows[k])
+				continue;
+			++colptr[cols[k] + 1];
+		}
+		for (int c = 0; c < nCols; ++c)
+			colptr[c + 1] += colptr[c];
+		int nKept = colptr[nCols];
+
+		// bucket the triplets by column (stable, so duplicates keep their order)
+		std::vector<int>    colRow(nKept);
+		std::vector<double> colVal(nKept);
+		std::vector<int>    next(colptr.begin(), colptr.end() - 1);
+		for (int k = 0; k < nTriplets; ++k) {
+			if (symmetric && cols[k] > rows[k])
+				continue;
+			int p = next[cols[k]]++;
+			colRow[p] = rows[k];
+			colVal[p] = values[k];
+		}
+
+		// sum the duplicates of each column in place and sort its row indices.
+		// position[r] is where row r was stored in the current column.
+		std::vector<int>    position(nRows, -1);
+		std::vector<double> columnValues;
+		int nnz = 0;
+		for (int c = 0; c < nCols; ++c) {
+			int begin = colptr[c];
+			int end = begin;
+			for (int p = colptr[c]; p < colptr[c + 1]; ++p) {
+				int r = colRow[p];
+				if (position[r] >= begin) 
+					colVal[position[r]] += colVal[p];		// duplicate
+				else {
+					position[r] = end;
+					colRow[end] = r;
+					colVal[end] = colVal[p];
+					++end;
+				}
+			}
+
+			if (! std::is_sorted(colRow.begin() + begin, colRow.begin() + end)) {
+				columnValues.assign(colVal.begin() + begin, colVal.begin() + end);
+				std::sort(colRow.begin() + begin, colRow.begin() + end);
+				for (int p = begin; p < end; ++p)
+					colVal[p] = columnValues[position[colRow[p]] - begin];
+			}
+
+			next[c] = end;
+			nnz += end - begin;
+		}
+
+		// compact the columns into the TAUCS matrix
+		taucs_ccs_matrix* mat = taucs_ccs_create(nRows, nCols, nnz, flags);
+		if (! mat)
+			return NULL;
+
+		int pos = 0;
+		for (int c = 0; c < nCols; ++c) {
+			int count = next[c] - colptr[c];
+			mat->colptr[c] = pos;
+			if (count > 0) {
+				memcpy(mat->rowind + pos, &colRow[colptr[c]], count * sizeof(int));
+				memcpy(mat->taucs_values + pos, &colVal[colptr[c]], count * sizeof(double));
+			}
+			pos += count;
+		}
+		mat->colptr[nCols] = pos;
+
+		return mat;
+	}
+
+
 	// Multiplies matA by x and stores the result in b. Assumes all memory has 
 	// been allocated and the sizes match; assumes matA is not symmetric!!
 	void MulNonSymmMatrixVector(const taucs_ccs_matrix* matA,
@@ -212,6 +330,45 @@ namespace TaucsUtil {
 	}
 
 
+	// Multiplies the transpose of matA by x and stores the result in b.
+	void MulNonSymmMatrixTransposeVector(const taucs_ccs_matrix* matA,
+		const double* x,
+		double* b)
+	{
+		// b[col] is the dot product of column col of matA and x
+		for (int col = 0; col < matA->n; ++col) {
+			double sum = 0;
+			for (int p = matA->colptr[col]; p < matA->colptr[col+1]; ++p)
+				sum += matA->taucs_values[p]*x[matA->rowind[p]];
+			b[col] = sum;
+		}
+	}
+
+
+	// Multiplies the symmetric matrix matA (storing its lower triangle) by x and 
+	// stores the result in b.
+	void MulSymmMatrixVector(const taucs_ccs_matrix* matA,
+		const double* x,
+		double* b)
+	{
+		// make b all zero
+		memset(b, 0, matA->m * sizeof(double));
+
+		for (int col = 0; col < matA->n; ++col) {
+			// a_{row,col} contributes to b[row], and (for the elements below
+			// the diagonal) a_{col,row} = a_{row,col} contributes to b[col]
+			double sum = 0;
+			for (int p = matA->colptr[col]; p < matA->colptr[col+1]; ++p) {
+				int row = matA->rowind[p];
+				b[row] += x[col]*matA->taucs_values[p];
+				if (row != col)
+					sum += matA->taucs_values[p]*x[row];
+			}
+			b[col] += sum;
+		}
+	}
+
+
 	//////////////////////////////////////////////////////////////////////////
 	// Adds two vectors vecA and VecB and stores the result in vecResult.
 	// Assumes all memory has been allocated and the sizes match!
@@ -239,4 +396,168 @@ namespace TaucsUtil {
 		return ret;
 	}
 
+	// Copy the double precision matrix mat to a new single precision matrix.
+	taucs_ccs_matrix* MatrixCopyToSingle(const taucs_ccs_matrix *mat) 
+	{
+		int flags = (mat->flags & ~TAUCS_DOUBLE) | TAUCS_SINGLE;
+		taucs_ccs_matrix* ret = taucs_ccs_create(mat->m, mat->n, mat->colptr[mat->n], flags);
+		if (! ret)
+			return NULL;
+
+		memcpy(ret->colptr, mat->colptr, sizeof(int) * (mat->n + 1));
+		memcpy(ret->rowind, mat->rowind, sizeof(int) * (mat->colptr[mat->n]));
+		for (int p = 0; p < mat->colptr[mat->n]; ++p)
+			ret->values.s[p] = static_cast<taucs_single>(mat->taucs_values[p]);
+
+		return ret;
+	}
+
+
+	//////////////////////////////////////////////////////////////////////////
+	// Creates the pattern of mat + mat^T, plus the diagonal, as a symmetric 
+	// matrix (lower triangle) whose values are all 1.
+	taucs_ccs_matrix* CreateSymmetricPattern(const taucs_ccs_matrix* mat)
+	{
+		int n = mat->n;
+		long long nnz = static_cast<long long>(mat->colptr[n]) + n;
+		if (nnz > std::numeric_limits<int>::max())
+			return NULL;
+
+		// Bucket the entries (i, j) by column min(i, j), with duplicates
+		std::vector<int> start(n + 1, 0);
+		for (int col = 0; col < n; ++col) {
+			++start[col + 1];		// the diagonal
+			for (int p = mat->colptr[col]; p < mat->colptr[col+1]; ++p)
+				++start[std::min(mat->rowind[p], col) + 1];
+		}
+		for (int col = 0; col < n; ++col)
+			start[col + 1] += start[col];
+
+		std::vector<int> rows(start[n]);
+		std::vector<int> next(start.begin(), start.end() - 1);
+		for (int col = 0; col < n; ++col) {
+			rows[next[col]++] = col;
+			for (int p = mat->colptr[col]; p < mat->colptr[col+1]; ++p) {
+				int row = mat->rowind[p];
+				rows[next[std::min(row, col)]++] = std::max(row, col);
+			}
+		}
+
+		// Sort the columns and remove the duplicates
+		std::vector<int> colptr(n + 1, 0);
+		int count = 0;
+		for (int col = 0; col < n; ++col) {
+			std::vector<int>::iterator begin = rows.begin() + start[col];
+			std::vector<int>::iterator end = rows.begin() + start[col + 1];
+			std::sort(begin, end);
+			end = std::unique(begin, end);
+			colptr[col] = count;
+			count = static_cast<int>(std::copy(begin, end, rows.begin() + count) - rows.begin());
+		}
+		colptr[n] = count;
+
+		taucs_ccs_matrix* ret = taucs_ccs_create(n, n, count, TAUCS_DOUBLE | TAUCS_SYMMETRIC | TAUCS_LOWER);
+		if (! ret)
+			return NULL;
+
+		memcpy(ret->colptr, &colptr[0], (n + 1) * sizeof(int));
+		if (count > 0)
+			memcpy(ret->rowind, &rows[0], count * sizeof(int));
+		std::fill(ret->taucs_values, ret->taucs_values + count, 1.0);
+
+		return ret;
+	}
+
+
+	//////////////////////////////////////////////////////////////////////////
+	// Computes the number of nonzeros of the Cholesky factor of mat and the
+	// number of floating point operations of the factorization.
+	void CholeskyFillEstimate(const taucs_ccs_matrix* mat,
+		double* nnzL,
+		double* flops)
+	{
+		int n = mat->n;
+
+		// The upper triangle, by columns: row k of the lower triangle
+		std::vector<int> start(n + 1, 0);
+		for (int col = 0; col < n; ++col) {
+			for (int p = mat->colptr[col]; p < mat->colptr[col+1]; ++p) {
+				if (mat->rowind[p] > col)
+					++start[mat->rowind[p] + 1];
+			}
+		}
+		for (int k = 0; k < n; ++k)
+			start[k + 1] += start[k];
+		std::vector<int> upper(start[n]);
+		std::vector<int> next(start.begin(), start.end() - 1);
+		for (int col = 0; col < n; ++col) {
+			for (int p = mat->colptr[col]; p < mat->colptr[col+1]; ++p) {
+				if (mat->rowind[p] > col)
+					upper[next[mat->rowind[p]]++] = col;
+			}
+		}
+
+		// The elimination tree (with path compression)
+		std::vector<int> parent(n, -1);
+		std::vector<int> ancestor(n, -1);
+		for (int k = 0; k < n; ++k) {
+			for (int p = start[k]; p < start[k + 1]; ++p) {
+				int i = upper[p];
+				while (i != -1 && i < k) {
+					int inext = ancestor[i];
+					ancestor[i] = k;
+					if (inext == -1)
+						parent[i] = k;
+					i = inext;
+				}
+			}
+		}
+
+		// The pattern of row k of L is the union of the paths from the nonzeros
+		// of row k of A up to k in the elimination tree
+		std::vector<int> mark(n, -1);
+		std::vector<double> count(n, 1.0);		// the diagonal
+		for (int k = 0; k < n; ++k) {
+			mark[k] = k;
+			for (int p = start[k]; p < start[k + 1]; ++p) {
+				for (int j = upper[p]; mark[j] != k; j = parent[j]) {
+					mark[j] = k;
+					count[j] += 1.0;
+				}
+			}
+		}
+
+		*nnzL = 0;
+		*flops = 0;
+		for (int j = 0; j < n; ++j) {
+			*nnzL += count[j];
+			*flops += count[j] * count[j];
+		}
+	}
+
+
+	// FNV-1a over size bytes, from hash
+	static unsigned long long HashBytes(unsigned long long hash, const void* data, std::size_t size) {
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+		for (std::size_t i = 0; i < size; ++i) {
+			hash ^= bytes[i];
+			hash *= 1099511628211ULL;
+		}
+		return hash;
+	}
+
+
+	unsigned long long Fingerprint(const taucs_ccs_matrix* mat)
+	{
+		int header[3] = { mat->m, mat->n, mat->flags & (TAUCS_SYMMETRIC | TAUCS_LOWER | TAUCS_DOUBLE) };
+		int nnz = mat->colptr[mat->n];
+
+		unsigned long long hash = 14695981039346656037ULL;
+		hash = HashBytes(hash, header, sizeof(header));
+		hash = HashBytes(hash, mat->colptr, (mat->n + 1) * sizeof(int));
+		hash = HashBytes(hash, mat->rowind, nnz * sizeof(int));
+		hash = HashBytes(hash, mat->taucs_values, nnz * sizeof(double));
+		return hash;
+	}
+
 }
\ No newline at end of file
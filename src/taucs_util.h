@@ -9,12 +9,18 @@ struct taucs_ccs_matrix;
 
 namespace TaucsUtil {
 
+	// The products below compute the columns of the result in parallel, with a
+	// dense accumulator per thread (see Parallel::default_num_threads()). The
+	// row indices of each column are sorted.
+
 	// Assuming nothing about the result (the result is NOT stored symmetric).
+	// Returns NULL if the result has more than 2^31-1 nonzeros.
 	taucs_ccs_matrix* Mul2NonSymmetricMatrices(
 		const taucs_ccs_matrix* matA,
 		const taucs_ccs_matrix* matB);
 
 	// For usage when it's known that the result is symmetric, like A^double * A.
+	// Returns NULL if the result has more than 2^31-1 nonzeros.
 	taucs_ccs_matrix* Mul2NonSymmMatSymmResult(
 		const taucs_ccs_matrix* matA,
 		const taucs_ccs_matrix* matB);
@@ -22,11 +28,29 @@ namespace TaucsUtil {
 	// Computes the transpose of a matrix.
 	taucs_ccs_matrix* MatrixTranspose(const taucs_ccs_matrix* mat);
 
+	// Returns NULL if the matrix has more than 2^31-1 nonzeros (TAUCS uses int).
 	taucs_ccs_matrix* CreateTaucsMatrixFromColumns(
 		const std::vector< std::map<int, double> >& cols, 
 		int nRows,
 		int flags);
 
+	// Builds a nRows x nCols matrix from nTriplets (rows[k], cols[k], values[k]) 
+	// triplets in any order. Duplicated entries are summed (in the order they 
+	// appear). If flags contains TAUCS_SYMMETRIC, only the lower triangle is kept
+	// and the triplets in the upper triangle are ignored. 
+	// The row indices of each column are sorted. The triplets are bucketed by 
+	// column with a counting sort, so the number of memory allocations does not 
+	// depend on nTriplets.
+	// Returns NULL if an index is out of range.
+	taucs_ccs_matrix* CreateTaucsMatrixFromTriplets(
+		int nRows,
+		int nCols,
+		int nTriplets,
+		const int* rows,
+		const int* cols,
+		const double* values,
+		int flags);
+
 	// Multiplies matA by x and stores the result in b. Assumes all memory has 
 	// been allocated and the sizes match; assumes matA is not symmetric!!
 	void MulNonSymmMatrixVector(
@@ -34,6 +58,23 @@ namespace TaucsUtil {
 		const double* x,
 		double* b);
 
+	// Multiplies the transpose of matA by x and stores the result in b, without
+	// forming the transpose. Assumes all memory has been allocated and the 
+	// sizes match (x has matA->m elements, b has matA->n); assumes matA is not
+	// symmetric!!
+	void MulNonSymmMatrixTransposeVector(
+		const taucs_ccs_matrix* matA,
+		const double* x,
+		double* b);
+
+	// Multiplies the symmetric matrix matA (storing its lower triangle) by x and 
+	// stores the result in b. Assumes all memory has been allocated and the 
+	// sizes match.
+	void MulSymmMatrixVector(
+		const taucs_ccs_matrix* matA,
+		const double* x,
+		double* b);
+
 	// Adds two vectors vecA and VecB and stores the result in vecResult.
 	// Assumes all memory has been allocated and the sizes match!
 	void Add2Vectors(
@@ -44,6 +85,32 @@ namespace TaucsUtil {
 
 	// Copy mat to a new matrix, memory will be allocated during the copy process.
 	taucs_ccs_matrix* MatrixCopy(const taucs_ccs_matrix* mat);
+
+	// Copy the double precision matrix mat to a new single precision (TAUCS_SINGLE)
+	// matrix with the same pattern.
+	taucs_ccs_matrix* MatrixCopyToSingle(const taucs_ccs_matrix* mat);
+
+	// Creates the pattern of mat + mat^T, plus the diagonal, for the square 
+	// non-symmetric matrix mat, as a symmetric matrix (lower triangle) whose 
+	// values are all 1. Used to compute symmetric orderings for LU factorizations.
+	// Returns NULL if the result has more than 2^31-1 nonzeros.
+	taucs_ccs_matrix* CreateSymmetricPattern(const taucs_ccs_matrix* mat);
+
+	// Computes the number of nonzeros of the Cholesky factor L of the symmetric
+	// matrix mat (lower triangle), and the number of floating point operations
+	// of the factorization (sum of the squares of the column counts), without 
+	// factoring it: elimination tree, then the pattern of each row of L.
+	// The cost is proportional to the number of nonzeros of L.
+	void CholeskyFillEstimate(
+		const taucs_ccs_matrix* mat,
+		double* nnzL,
+		double* flops);
+
+	// Returns a 64-bit fingerprint (FNV-1a hash) of the dimensions, the flags, 
+	// the pattern and the values of mat: matrices with different fingerprints
+	// differ, and matrices with the same fingerprint are equal (up to the 
+	// collisions of the hash).
+	unsigned long long Fingerprint(const taucs_ccs_matrix* mat);
 };
 
 